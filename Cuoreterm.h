@@ -3,24 +3,215 @@
 
 #include <stdint.h>
 #include <stdbool.h>
+#include <stdarg.h>
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+#ifndef CUORETERM_GLYPH_CACHE_SLOTS
+#define CUORETERM_GLYPH_CACHE_SLOTS 8 // max colours the glyph cache keeps resident at once
+#endif
+
+#ifndef CUORETERM_GLYPH_CACHE_GLYPHS
+#define CUORETERM_GLYPH_CACHE_GLYPHS 256 // glyphs per cache slot (multiple of 32), ones past it are drawn from the font
+#endif
+
+// draws the set bits of an 8 pixel wide glyph h rows tall in native colour col, leaving the rest alone
+typedef void (*cuoreterm_glyph_fn)(uint8_t *dst, uint32_t pitch, const uint8_t *glyph, uint32_t h, uint32_t col);
+
+// draws all 8 pixels of every row, set bits in fg and the rest in bg
+typedef void (*cuoreterm_opaque_fn)(uint8_t *dst, uint32_t pitch, const uint8_t *glyph, uint32_t h, uint32_t fg, uint32_t bg);
+
+// parallel rendering hook: must call fn(arg, i) exactly once for every i < count, in any order and on
+// any cpu, and only return once all of them have
+typedef void (*cuoreterm_task_fn)(void *arg, uint32_t index);
+typedef void (*cuoreterm_run_tasks_fn)(void *ctx, cuoreterm_task_fn fn, void *arg, uint32_t count);
+
+// how r, g and b are packed into one fb pixel, shifts count up from bit 0 of the pixel (these are
+// the red/green/blue_mask_size/shift fields limine reports). identical masks for all three mean grayscale
+struct cuoreterm_format {
+    uint8_t bpp;
+    uint8_t r_size, r_shift;
+    uint8_t g_size, g_shift;
+    uint8_t b_size, b_shift;
+};
+
+struct cuoreterm_pixel_ops;
+
+// a font already taken apart by tools/cuorefont.c, usable straight from rodata by any number of terminals.
+// glyph g is glyph_bytes (padded for alignment) at glyphs + g * glyph_bytes, rows of stride bytes with the
+// msb the left pixel. map is the codepoint -> glyph index set_font would build, codepoints past it draw missing
+struct cuoreterm_font {
+    uint32_t glyph_w, glyph_h;
+    uint32_t stride, glyph_bytes;
+    uint32_t glyph_count;
+    const uint8_t *glyphs;
+    const uint16_t *map;
+    uint32_t map_size;
+    uint16_t missing;
+    // optional: every glyph already expanded into whole glyph_w x glyph_h cells of pixel_fmt pixels in
+    // pixel_fg on pixel_bg (0xRRGGBB), drawn by row copies like the glyph cache. NULL for none
+    const uint8_t *pixels;
+    struct cuoreterm_format pixel_fmt;
+    uint32_t pixel_fg, pixel_bg;
+};
+
+#ifndef CUORETERM_DIRTY_ROWS
+#define CUORETERM_DIRTY_ROWS 512 // grid rows tracked one by one, rows past it are redrawn whenever in the dirty range
+#endif
+
+#ifndef CUORETERM_MAX_HEADS
+#define CUORETERM_MAX_HEADS 4 // framebuffers mirrored on top of the one given at init
+#endif
+
+// another framebuffer showing the same text, see cuoreterm_add_head
+struct cuoreterm_head {
+    void *addr;
+    uint32_t width, height, pitch;
+    struct cuoreterm_format fmt;
+    uint8_t pixel_bytes;
+};
+
+#ifndef CUORETERM_VT_PARAMS
+#define CUORETERM_VT_PARAMS 16 // csi parameters kept, extra ones are dropped
+#endif
+
+// escape sequence parser state, kept across writes so a sequence split between two writes still works
+struct cuoreterm_vt {
+    uint8_t state;
+    uint8_t nparams;
+    uint16_t params[CUORETERM_VT_PARAMS];
+    uint32_t hex;  // ESC[#RRGGBBm colour being read
+    uint8_t nhex;
+    uint32_t saved_x, saved_y; // ESC 7 / ESC 8
+    uint32_t utf8, utf8_min;   // utf-8 sequence being read and the smallest codepoint it may encode
+    uint8_t utf8_need;         // continuation bytes still to come
+};
+
+// one character cell of the text grid, ch is a unicode codepoint and 0 an empty cell (still painted in bg)
+struct cuoreterm_cell {
+    uint32_t ch;
+    uint32_t fg;
+    uint32_t bg;
+};
+
+#ifdef CUORETERM_STATS
+// counters for where console time goes, only there when CUORETERM_STATS is defined (the same in every
+// file that includes this header, it changes struct terminal). cycles are rdtsc ticks and nest: glyph
+// drawing and scrolling done by a write are counted in cycles_write too
+struct cuoreterm_stats {
+    uint64_t glyphs;          // glyphs rasterised
+    uint64_t scrolls;         // scroll operations, several lines scrolled by one write are one
+    uint64_t scroll_rows;     // text rows moved by them
+    uint64_t escapes;         // escape sequences dispatched
+    uint64_t fb_written;      // bytes stored to the framebuffer itself (not the shadow)
+    uint64_t fb_read;         // bytes read back from the framebuffer
+    uint64_t cycles_write;
+    uint64_t cycles_present;
+    uint64_t cycles_scroll;
+    uint64_t cycles_clear;
+    uint64_t cycles_glyph;
+};
+#endif
+
 struct terminal {
-    void *fb_addr;
-    uint32_t fb_width, fb_height, fb_pitch, fb_bpp;
+    void *fb_addr;     // top left of the pane, the framebuffer itself unless cuoreterm_set_pane moved it
+    uint32_t fb_width, fb_height, fb_pitch, fb_bpp; // width and height are the pane's
+
+    void *shadow_addr; // optional system ram back buffer (fb_pitch * fb_height bytes), NULL for direct mode
+    void *draw_addr;   // where drawing happens, shadow_addr in shadow mode otherwise fb_addr
+
+    void *screen_fb, *screen_shadow;      // the whole framebuffer and shadow the pane is cut from
+    uint32_t screen_width, screen_height;
+    uint32_t pane_x, pane_y;              // pixel origin of the pane in them
+    uint32_t dirty_x0, dirty_y0, dirty_x1, dirty_y1; // pixel rect of the shadow not yet copied to fb
+
+    struct cuoreterm_head heads[CUORETERM_MAX_HEADS]; // mirrors fed from the shadow
+    uint32_t nheads;
 
-    uint32_t fgcol;
+    uint32_t fgcol, bgcol;   // 0xRRGGBB, what cells and the cache keys remember
+    uint32_t fg_px, bg_px;   // the same packed for the fb
+    uint32_t palette[256];   // xterm colours packed for the fb, rebuilt with the format
     uint32_t cursor_x, cursor_y;
-    uint8_t r_offset, g_offset, b_offset; // byte offsets in fb pixel
+    struct cuoreterm_vt vt;
+    struct cuoreterm_format fmt;
     uint8_t pixel_bytes; // number of bytes per pixel
+    const struct cuoreterm_pixel_ops *ops; // renderers specialised for pixel_bytes, picked with the format
+    cuoreterm_glyph_fn glyph_blit; // best kernel for pixel_bytes on this cpu, picked at init
+    cuoreterm_opaque_fn opaque_blit; // same for opaque drawing
+    void (*fb_fill)(void *dst, uint8_t v, uint32_t n);              // streaming fill for framebuffer clears
+    void (*fb_copy)(void *dst, const void *src, uint32_t n);        // streaming forward copy for scroll/flush
+    void (*mem_fill)(void *dst, uint8_t v, uint32_t n);             // the same into the shadow, which stays cached
+    void (*mem_copy)(void *dst, const void *src, uint32_t n);
 
-    const uint8_t *font_data;
+    const uint8_t *font_data;       // the font as given
+    const uint8_t *font_bits;       // its glyph 0, rows of font_stride bytes, msb is the left pixel
+    const uint8_t *font_table;      // its unicode table, NULL for none
+    const uint8_t *font_end;        // one past the font, NULL when its size was not given
+    bool font_table_utf8;           // psf2 tables are utf-8, psf1 ones 16 bit
+    uint32_t font_glyph_w, font_glyph_h, font_stride, font_bytes;
+    uint32_t cell_w, cell_h;        // unscaled cell
+    uint32_t scale;                 // integer scale, 1 unless an atlas big enough was given
+    uint8_t *atlas;                 // optional font_bits scaled up, what font_glyphs points at when scaled
+    uint32_t atlas_size;
+
+    // what is drawn: the font or its scaled atlas, in cells of font_width x font_height
+    const uint8_t *font_glyphs;
     uint32_t font_width, font_height;
+    uint32_t glyph_count, glyph_stride, glyph_bytes;
+    uint32_t glyph_w, glyph_h;      // pixels of each glyph drawn, the font's size clipped to the cell
+    const uint16_t *font_map;       // codepoint -> glyph, font_map_buf or a compiled font's
+    uint32_t font_map_size;         // codepoints it covers
+    uint16_t font_missing;          // glyph for every codepoint the font lacks
+    uint16_t *font_map_buf;         // where set_font builds the map, font_low unless the caller gave a bigger one
+    uint32_t font_map_cap;
+    uint16_t font_low[256];
+    const struct cuoreterm_font *font_compiled; // set by cuoreterm_set_compiled_font, NULL for a psf font
+    const uint8_t *font_pixels;     // its pre-expanded cells while they match the format and scale, else NULL
+    uint32_t font_pixels_fg, font_pixels_bg; // packed colours they were expanded in
 
     uint32_t cols, rows;
+    uint32_t scroll_top, scroll_bottom; // rows a newline on the bottom one scrolls (ESC[t;br), bottom exclusive
+
+    bool opaque;            // glyphs paint their whole cell in fg/bg instead of only the set bits
+    bool deferred;          // writes only update state and damage, cuoreterm_present puts it on screen
+    bool measuring;         // dry run of a write that only walks the cursor to count scrolls
+    bool measure_abort;     // it scrolled a region, which can't be done up front
+    uint32_t scroll_ahead;  // scrolls already done up front that the cursor has not caught up with yet
+
+    struct cuoreterm_cell *cells; // optional cols * rows text grid used as a ring of rows, NULL for pixel only mode
+    uint32_t grid_cap;            // number of cells the caller gave us
+    uint32_t grid_head;           // ring index of the row shown at the top of the screen
+    uint32_t grid_dirty0, grid_dirty1; // grid rows to re-render on the next present
+    uint64_t grid_dirty_bits[(CUORETERM_DIRTY_ROWS + 63) / 64]; // which rows in that range actually changed
+    struct cuoreterm_cell *prev;  // optional cols * rows copy of what is on screen, indexed by screen row
+    uint32_t prev_cap;            // cells prev holds, it is dropped when cols * rows outgrows them
+
+    uint8_t *sb;                  // optional ring of line records scrolled off the grid, NULL for none
+    uint32_t sb_size;             // usable bytes of it, a multiple of 4
+    uint32_t sb_head, sb_tail;    // next free byte and oldest record
+    uint32_t sb_used, sb_lines;   // bytes and lines held, pad at the end of the ring counts as used
+    uint32_t sb_wrap;             // where the records before the last wrap end
+    uint32_t sb_last;             // newest record
+    uint32_t sb_find_off, sb_find_back; // last record looked up and how many lines back it is, back 0 is none
+    uint32_t sb_view;             // lines back from live the top of the screen is scrolled, 0 is live
+    bool view_redraw;             // the view moved, every screen row needs rendering
+
+    cuoreterm_run_tasks_fn run_tasks; // optional hook that spreads grid rendering over cpus, NULL for serial
+    void *tasks_ctx;
+    uint32_t tasks;                   // most bands to split a redraw into
+
+    uint8_t *gcache;            // optional glyphs pre-converted to fb pixels, one slot of 256 glyphs per colour
+    uint32_t gcache_size;       // bytes the caller gave us
+    uint32_t gcache_slots, gcache_used, gcache_next, gcache_last;
+    uint32_t gcache_fg[CUORETERM_GLYPH_CACHE_SLOTS];       // colours each slot was expanded for
+    uint32_t gcache_bg[CUORETERM_GLYPH_CACHE_SLOTS];
+    uint32_t gcache_built[CUORETERM_GLYPH_CACHE_SLOTS][CUORETERM_GLYPH_CACHE_GLYPHS / 32]; // glyphs already expanded per slot
+
+#ifdef CUORETERM_STATS
+    struct cuoreterm_stats stats;
+#endif
 };
 
 void cuoreterm_init(
@@ -35,22 +226,202 @@ void cuoreterm_init(
     uint32_t font_h
 );
 
+// same as cuoreterm_init but draws into a caller supplied back buffer of fb_pitch * fb_height bytes
+// and only copies changed spans to the framebuffer, so scrolling never reads back from vram
+void cuoreterm_init_shadow(
+    struct terminal *term,
+    void *fb_addr,
+    uint32_t fb_width,
+    uint32_t fb_height,
+    uint32_t fb_pitch,
+    uint32_t fb_bpp,
+    void *shadow,
+    const uint8_t *font,
+    uint32_t font_w,
+    uint32_t font_h
+);
+
+// everything cuoreterm_init_arena sets up in one go, zero for whatever is not wanted
+struct cuoreterm_config {
+    void *fb_addr;
+    uint32_t fb_width, fb_height, fb_pitch, fb_bpp;
+    const struct cuoreterm_format *fmt;      // NULL keeps the guess from bpp
+    const uint8_t *font;                     // psf font and cell as for cuoreterm_init
+    uint32_t font_size;                      // bytes of font as for cuoreterm_set_font_sized, 0 trusts its header
+    uint32_t font_w, font_h;
+    const struct cuoreterm_font *compiled;   // or a compiled font instead of font
+    uint32_t pane_x, pane_y, pane_w, pane_h; // pane_w 0 for the whole framebuffer
+    uint32_t scale;                          // 2, 3, 4 draws scaled, 0 or 1 does not
+    uint32_t font_map;                       // codepoints the font map covers, 0 for the built in 256
+    bool shadow;
+    bool grid;
+    bool grid_diff;                          // needs grid
+    uint32_t glyph_cache;                    // colour pairs the glyph cache holds, 0 for none
+    uint32_t scrollback;                     // bytes of history, needs grid, 0 for none
+};
+
+// bytes of arena cuoreterm_init_arena needs for cfg. it loads the font into a struct terminal on the
+// stack to learn the geometry, nothing else is touched. 0 when cfg->font or cfg->fmt is rejected
+uint64_t cuoreterm_required_memory(const struct cuoreterm_config *cfg);
+
+// init and give the terminal every buffer cfg asks for out of one arena, 64 byte aligned (a misaligned
+// one costs up to 63 bytes more). each buffer starts on a cache line and the grid, its prev copy and the
+// glyph cache come first, the history, map and shadow behind them. nothing is allocated later either,
+// a different font or scale makes do with the same buffers. false, and the terminal without any of
+// them, when size is short of cuoreterm_required_memory or cfg->font or cfg->fmt is rejected
+bool cuoreterm_init_arena(struct terminal *term, const struct cuoreterm_config *cfg, void *arena, uint64_t size);
+
 void cuoreterm_write(void *ctx, const char *msg, uint64_t len);
-void cuoreterm_draw_char(struct terminal *term, char c, uint32_t fg);
+
+// formatted output without a staging buffer: literal text is fed from fmt as is and numbers are
+// converted into a few dozen bytes of stack, so it is fine in early boot. drawing uses sse/avx unless
+// CUORETERM_NO_SIMD is defined, so from an interrupt handler only if it saves the vector state.
+// knows %d %i %u %x %X %o %p %c %s %% with the - + space # 0 flags, width, precision (also *)
+// and the hh h l ll z j t sizes
+void cuoreterm_printf(struct terminal *term, const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+void cuoreterm_vprintf(struct terminal *term, const char *fmt, va_list ap);
+void cuoreterm_write_str(struct terminal *term, const char *s);
+void cuoreterm_write_dec(struct terminal *term, int64_t v);
+void cuoreterm_write_hex(struct terminal *term, uint64_t v, uint32_t digits); // zero padded to digits, no 0x
+
+void cuoreterm_draw_char(struct terminal *term, char c, uint32_t fg); // on the current bg
+
+// psf1 or psf2 font of any glyph size. font_w x font_h is the cell, 0 takes the font's own glyph size;
+// glyphs are clipped to it and the rest of the cell is background. writes are utf-8, the font's unicode
+// table (psf1 mode 2, psf2 flag 1) is turned into a codepoint -> glyph table once here so each character
+// is one lookup, codepoints it lacks draw U+FFFD or '?'. fonts without a table are indexed by codepoint.
+// the header is trusted, fine for a font built in
 void cuoreterm_set_font(struct terminal *term, const uint8_t *font, uint32_t font_w, uint32_t font_h);
+
+// the same for a font of size bytes, e.g. one read from disk: nothing past them is read, and false with the
+// old font kept when the header is broken or the glyphs or table don't fit in size (0 trusts the header)
+bool cuoreterm_set_font_sized(struct terminal *term, const uint8_t *font, uint32_t size, uint32_t font_w, uint32_t font_h);
+
+// the terminal's own table covers codepoints below 256, give it map with room for entries codepoints
+// (65536 for the whole bmp, 128 KiB) to reach box drawing, greek, cyrillic etc. rebuilt by every
+// cuoreterm_set_font, NULL goes back to the built in one
+void cuoreterm_set_font_map(struct terminal *term, uint16_t *map, uint32_t entries);
+
+// use a font compiled ahead of time (see tools/cuorefont.c), the cell is its glyph size. nothing is
+// parsed or built and the terminal only points at font, so it can be const and shared. its pixels are
+// used for cells in exactly their colours while drawing is opaque, in their format and unscaled.
+// init takes a NULL psf font to be followed by this, until a font is set nothing is drawn
+void cuoreterm_set_compiled_font(struct terminal *term, const struct cuoreterm_font *font);
+
+// draw every glyph scale times bigger (2, 3, 4 for hidpi panels), cols and rows shrink to match. the
+// font is scaled once into atlas (cuoreterm_scale_atlas_size bytes) so drawing costs the same per
+// pixel as at 1x, with the glyph cache a cell row is one copy. cuoreterm_set_font rescales into the
+// same atlas and drops back to 1x if it no longer fits. resets the grid like set_font, call it early.
+// false, and unscaled, when atlas is too small; scale 1 or NULL turns it off
+bool cuoreterm_set_scale(struct terminal *term, uint32_t scale, void *atlas, uint32_t size);
+uint32_t cuoreterm_scale_atlas_size(struct terminal *term, uint32_t scale);
+
 void cuoreterm_clear(struct terminal *term);
 
+// replace the pixel format guessed from bpp at init, e.g. with the masks limine reports for bgr panels.
+// false, and the format left as it was, unless bpp is 1-32 and every channel is 1-16 bits inside the pixel
+bool cuoreterm_set_format(struct terminal *term, const struct cuoreterm_format *fmt);
+
+// mirror the terminal onto another framebuffer, e.g. the other ones limine reports. needs a shadow:
+// text is rendered once into it and every present converts the changed rect to each head's own
+// format and pitch, clipped to its size. false when there is no shadow, CUORETERM_MAX_HEADS are in use
+// or fmt is not one set_format takes
+bool cuoreterm_add_head(struct terminal *term, void *fb_addr, uint32_t width, uint32_t height, uint32_t pitch,
+                        const struct cuoreterm_format *fmt);
+
+// confine the terminal to the w x h pixel rectangle at x, y of its framebuffer, e.g. a one line status
+// pane above a log pane. cols and rows follow the rectangle and scrolling only moves its rows. the shadow
+// stays screen sized (same pitch and height as the fb) so panes of one framebuffer can share one, each
+// flushing only its own rect, and heads are mirrored at the same position. resets the grid like set_font
+void cuoreterm_set_pane(struct terminal *term, uint32_t x, uint32_t y, uint32_t w, uint32_t h);
+
+// keep the screen as a grid of cells, scrolling then only advances a ring index and pixels get
+// re-rendered from the grid at the end of each write. cells must hold count entries, if it is
+// smaller than cols * rows the terminal uses fewer rows. call right after init, NULL turns it off
+void cuoreterm_set_grid(struct terminal *term, struct cuoreterm_cell *cells, uint32_t count);
+
+// with the grid, remember the cells last put on screen in prev (at least as many as the grid uses) and
+// have present only rasterise cells that differ, for programs that rewrite the whole screen every frame.
+// call after cuoreterm_set_grid, NULL turns it off. a later font, scale or pane that needs more than
+// count cells turns it off as well
+void cuoreterm_set_grid_diff(struct terminal *term, struct cuoreterm_cell *prev, uint32_t count);
+
+// opaque drawing: every glyph overwrites its whole cell in the current fg and bg (ESC[40-47m etc),
+// so text redrawn in place never needs clearing first. the grid and the glyph cache always draw opaque
+void cuoreterm_set_opaque(struct terminal *term, bool on);
+
+// cache glyphs already converted to the fb pixel format so drawing one is a few row copies,
+// each fg/bg pair takes cuoreterm_glyph_cache_slot_size bytes and glyphs are expanded on first use.
+// cached glyphs paint their background too. NULL turns it off
+void cuoreterm_set_glyph_cache(struct terminal *term, void *buf, uint32_t size);
+uint32_t cuoreterm_glyph_cache_slot_size(struct terminal *term);
+
+// scrollback: lines scrolling off the top of the grid are kept in buf as compact records (runs of
+// colour plus the text, trailing blanks trimmed), the oldest go when it is full. needs the grid.
+// the view scrolls back by whole lines and stays put as new lines arrive, moving it only re-renders
+// the rows on screen. ESC[3J empties it. NULL turns it off
+void cuoreterm_set_scrollback(struct terminal *term, void *buf, uint32_t size);
+uint32_t cuoreterm_scrollback_lines(struct terminal *term);
+uint32_t cuoreterm_scrollback_bytes(struct terminal *term); // bytes of buf in use
+void cuoreterm_set_view(struct terminal *term, uint32_t lines_back); // 0 is live, clamped to what is kept
+void cuoreterm_scroll_view(struct terminal *term, int32_t lines);    // positive goes back in time
+
+// split the grid rows a present re-renders into up to tasks horizontal bands and hand them to run.
+// bands touch disjoint pixels and no shared state (they skip the glyph cache), so the result is the
+// same as rendering them in order. your cpus must have sse enabled like the one calling present.
+// NULL or tasks < 2 renders serially
+void cuoreterm_set_task_hook(struct terminal *term, cuoreterm_run_tasks_fn run, void *ctx, uint32_t tasks);
+
+// deferred presentation: writes only update the shadow/grid and record damage, and cuoreterm_present
+// (e.g. from a timer tick at whatever rate you like) pushes everything since the last one in one go.
+// needs a shadow or a grid to defer into, direct mode always draws straight away.
+// cuoreterm_write_sync ignores deferral and is on screen when it returns, use it for panics
+void cuoreterm_set_deferred(struct terminal *term, bool on);
+void cuoreterm_present(struct terminal *term);
+void cuoreterm_write_sync(void *ctx, const char *msg, uint64_t len);
+
+#ifdef CUORETERM_STATS
+void cuoreterm_get_stats(struct terminal *term, struct cuoreterm_stats *out);
+void cuoreterm_reset_stats(struct terminal *term);
+#endif
+
+// lock free multi producer single consumer front end. any cpu can cuoreterm_queue_write (same
+// signature as cuoreterm_write so it plugs into the same log sink) and pays a copy plus one cas,
+// one cpu calls cuoreterm_queue_drain to render. every write is one record so lines never interleave,
+// a write that does not fit is dropped and counted. init rounds size down to a power of two (a buffer
+// under 8 bytes takes nothing), writes up to size / 2 - 4 bytes always fit an empty queue
+struct cuoreterm_queue {
+    uint8_t *buf;
+    uint32_t size;     // power of two, or 0
+    uint32_t dropped;
+    uint32_t reserve __attribute__((aligned(64))); // producers claim space here
+    uint32_t tail __attribute__((aligned(64)));    // consumer frees space here
+};
+
+void cuoreterm_queue_init(struct cuoreterm_queue *q, void *buf, uint32_t size);
+void cuoreterm_queue_write(void *ctx, const char *msg, uint64_t len);
+uint32_t cuoreterm_queue_drain(struct cuoreterm_queue *q, struct terminal *term); // returns records rendered
+
 #ifdef __cplusplus
 }
 #endif
 
 #ifdef CUORETERM_IMPL
 
+#if defined(__x86_64__)
+#define CUORETERM_X86
+#endif
+
+#if defined(CUORETERM_X86) && !defined(CUORETERM_NO_SIMD)
+#define CUORETERM_X86_SIMD
+#include <immintrin.h>
+#endif
+
 static void *h_memset(void *dst, uint8_t v, uint32_t n) {
     uint8_t *p = dst;
     uint32_t val32 = v | (v << 8) | (v << 16) | (v << 24);
 
-    while (((uintptr_t)p & 3) && n--) *p++ = v;
+    while (((uintptr_t)p & 3) && n) { *p++ = v; n--; }
 
     uint32_t *p32 = (uint32_t*)p;
     while (n >= 4) { *p32++ = val32; n -= 4; }
@@ -98,211 +469,2681 @@ static void *h_memmove(void *dst, const void *src, uint32_t n) {
     return dst;
 }
 
-static inline void fb_pixel(struct terminal *term, uint32_t x, uint32_t y, uint32_t fg) {
-    if (x >= term->fb_width || y >= term->fb_height) return;
+#define TERM_CPU_SSE2 (1u << 0)
+#define TERM_CPU_AVX2 (1u << 1)
+#define TERM_CPU_ERMS (1u << 2)
 
-    uint8_t *p = (uint8_t*)term->fb_addr + y * term->fb_pitch + x * term->pixel_bytes;
+static uint32_t term_cpu_features(void) {
+    uint32_t feat = 0;
+#ifdef CUORETERM_X86
+    uint32_t a, b, c, d;
 
-    switch(term->pixel_bytes) {
-        case 4: // 32bpp ARGB/RGB
-        case 3: // 24bpp RGB
-            p[term->r_offset] = (uint8_t)((fg >> 16) & 0xFF);
-            p[term->g_offset] = (uint8_t)((fg >> 8) & 0xFF);
-            p[term->b_offset] = (uint8_t)(fg & 0xFF);
-            break;
-        case 2: { // RGB565
-            uint16_t val = ((((fg >> 16) * 31 + 127) / 255) << 11) |
-                           ((((fg >> 8 & 0xFF) * 63 + 127) / 255) << 5) |
-                           (((fg & 0xFF) * 31 + 127) / 255);
-            *(uint16_t*)p = val;
-            break;
-        }
-        case 1: // grayscale
-            p[0] = (uint8_t)(((fg >> 16) + ((fg >> 8) & 0xFF) + (fg & 0xFF)) / 3);
-            break;
+    __asm__ volatile("cpuid" : "=a"(a), "=b"(b), "=c"(c), "=d"(d) : "a"(0), "c"(0));
+    uint32_t max_leaf = a;
+
+    __asm__ volatile("cpuid" : "=a"(a), "=b"(b), "=c"(c), "=d"(d) : "a"(1), "c"(0));
+    if (d & (1u << 26)) feat |= TERM_CPU_SSE2;
+
+    // avx2 also needs the os to save ymm state (osxsave + xcr0 sse/avx bits)
+    bool ymm_ok = false;
+    if ((c & (1u << 27)) && (c & (1u << 28))) {
+        uint32_t xlo, xhi;
+        __asm__ volatile("xgetbv" : "=a"(xlo), "=d"(xhi) : "c"(0));
+        ymm_ok = (xlo & 6) == 6;
+    }
+
+    if (max_leaf >= 7) {
+        __asm__ volatile("cpuid" : "=a"(a), "=b"(b), "=c"(c), "=d"(d) : "a"(7), "c"(0));
+        if (ymm_ok && (b & (1u << 5))) feat |= TERM_CPU_AVX2;
+        if (b & (1u << 9)) feat |= TERM_CPU_ERMS;
     }
+#endif
+    return feat;
 }
 
-void cuoreterm_init(
-    struct terminal *term,
-    void *fb_addr,
-    uint32_t fb_width,
-    uint32_t fb_height,
-    uint32_t fb_pitch,
-    uint32_t fb_bpp,
-    const uint8_t *font,
-    uint32_t font_w,
-    uint32_t font_h
-) {
-    term->fb_addr   = fb_addr;
-    term->fb_width  = fb_width;
-    term->fb_height = fb_height;
-    term->fb_pitch  = fb_pitch;
-    term->fb_bpp    = fb_bpp;
+#ifdef CUORETERM_STATS
+static inline uint64_t term_rdtsc(void) {
+#ifdef CUORETERM_X86
+    uint32_t lo, hi;
+    __asm__ volatile("rdtsc" : "=a"(lo), "=d"(hi));
+    return ((uint64_t)hi << 32) | lo;
+#else
+    return 0;
+#endif
+}
 
-    term->fgcol = 0xFFFFFF;
+// atomic since render bands may run on several cpus at once
+#define TERM_STAT_ADD(term, field, n) __atomic_fetch_add(&(term)->stats.field, (n), __ATOMIC_RELAXED)
+#define TERM_STAT_START(t0) uint64_t t0 = term_rdtsc()
+#define TERM_STAT_CYCLES(term, field, t0) TERM_STAT_ADD(term, field, term_rdtsc() - (t0))
+// drawing only reaches the framebuffer straight away when there is no shadow in between
+#define TERM_STAT_DRAWN(term, n) do { if (!(term)->shadow_addr) TERM_STAT_ADD(term, fb_written, n); } while (0)
+#else
+#define TERM_STAT_ADD(term, field, n) ((void)0)
+#define TERM_STAT_START(t0) ((void)0)
+#define TERM_STAT_CYCLES(term, field, t0) ((void)0)
+#define TERM_STAT_DRAWN(term, n) ((void)0)
+#endif
 
-    term->cursor_x = 0;
-    term->cursor_y = 0;
-    term->pixel_bytes = fb_bpp / 8;
+// order the non temporal stores of the simd kernels and fb fill/copy before anything that follows
+static inline void term_store_fence(void) {
+#ifdef CUORETERM_X86
+    __asm__ volatile("sfence" ::: "memory");
+#endif
+}
 
-    cuoreterm_set_font(term, font, font_w, font_h);
+// fills and copies aimed at the framebuffer, which is write combined and far bigger than the cache, so
+// streaming stores win there. the shadow is ordinary write back memory that the next flush reads straight
+// back, so it gets fast strings instead, which keep the lines cached. below TERM_STREAM_MIN bytes the
+// setup of either is not worth it. copies go forward only, which is what scrolling up needs when they overlap
+#define TERM_STREAM_MIN 256
 
-    switch(fb_bpp) {
-        case 32: term->r_offset=2; term->g_offset=1; term->b_offset=0; break; // ARGB
-        case 24: term->r_offset=0; term->g_offset=1; term->b_offset=2; break; // RGB
-        case 16: term->r_offset=0; term->g_offset=0; term->b_offset=0; break; // RGB565
-        case 8:  term->r_offset=0; term->g_offset=0; term->b_offset=0; break; // grayscale
-        default: term->r_offset=0; term->g_offset=0; term->b_offset=0; break;
-    }
+typedef void (*term_fill_fn)(void *dst, uint8_t v, uint32_t n);
+typedef void (*term_copy_fn)(void *dst, const void *src, uint32_t n);
+
+static void term_fill_plain(void *dst, uint8_t v, uint32_t n) { h_memset(dst, v, n); }
+static void term_copy_plain(void *dst, const void *src, uint32_t n) { h_memmove(dst, src, n); }
+
+#ifdef CUORETERM_X86
+// rep stosb/movsb with enhanced fast strings, no vector state needed
+static void term_fill_erms(void *dst, uint8_t v, uint32_t n) {
+    uint64_t cnt = n;
+    __asm__ volatile("rep stosb" : "+D"(dst), "+c"(cnt) : "a"(v) : "memory");
 }
 
-static void term_scroll(struct terminal *term) {
-    uint32_t nrows = 1;
+static void term_copy_erms(void *dst, const void *src, uint32_t n) {
+    uint64_t cnt = n;
+    __asm__ volatile("rep movsb" : "+D"(dst), "+S"(src), "+c"(cnt) : : "memory");
+}
+
+// movnti streams 8 bytes from a general register, also fine in kernels built without sse
+static void term_fill_movnti(void *dst, uint8_t v, uint32_t n) {
+    uint8_t *p = (uint8_t*)dst;
+    uint64_t v64 = 0x0101010101010101ull * v;
+
+    while (((uintptr_t)p & 7) && n) { *p++ = v; n--; }
+    for (; n >= 8; p += 8, n -= 8) __asm__ volatile("movnti %1, %0" : "=m"(*(uint64_t*)p) : "r"(v64));
+    while (n--) *p++ = v;
+}
 
-    uint32_t row_bytes = term->fb_pitch * term->font_height * nrows;
-    uint8_t *fb = (uint8_t*)term->fb_addr;
+static void term_copy_movnti(void *dst, const void *src, uint32_t n) {
+    uint8_t *d = (uint8_t*)dst;
+    const uint8_t *s = (const uint8_t*)src;
+
+    while (((uintptr_t)d & 7) && n) { *d++ = *s++; n--; }
+    for (; n >= 8; d += 8, s += 8, n -= 8) __asm__ volatile("movnti %1, %0" : "=m"(*(uint64_t*)d) : "r"(*(const uint64_t*)s));
+    while (n--) *d++ = *s++;
+}
+#endif
 
-    h_memmove(fb, fb + row_bytes, (term->fb_height - term->font_height * nrows) * term->fb_pitch);
-    h_memset(fb + (term->fb_height - term->font_height * nrows) * term->fb_pitch, 0x00, row_bytes);
+#ifdef CUORETERM_X86_SIMD
+// movntdq, a full 64 byte line per iteration so the write combining buffers flush whole lines
+__attribute__((target("sse2")))
+static void term_fill_ntdq(void *dst, uint8_t v, uint32_t n) {
+    uint8_t *p = (uint8_t*)dst;
+    const __m128i x = _mm_set1_epi8((char)v);
 
-    term->cursor_y = (term->cursor_y >= nrows) ? (term->cursor_y - nrows) : 0;
+    while (((uintptr_t)p & 15) && n) { *p++ = v; n--; }
+    for (; n >= 64; p += 64, n -= 64) {
+        _mm_stream_si128((__m128i*)p, x);
+        _mm_stream_si128((__m128i*)(p + 16), x);
+        _mm_stream_si128((__m128i*)(p + 32), x);
+        _mm_stream_si128((__m128i*)(p + 48), x);
+    }
+    for (; n >= 16; p += 16, n -= 16) _mm_stream_si128((__m128i*)p, x);
+    while (n--) *p++ = v;
 }
 
-void cuoreterm_draw_char(struct terminal *term, char c, uint32_t fg) {
-    if (c == '\n') { term->cursor_x = 0; term->cursor_y++; if(term->cursor_y >= term->rows) term_scroll(term); return; }
+__attribute__((target("sse2")))
+static void term_copy_ntdq(void *dst, const void *src, uint32_t n) {
+    uint8_t *d = (uint8_t*)dst;
+    const uint8_t *s = (const uint8_t*)src;
+
+    while (((uintptr_t)d & 15) && n) { *d++ = *s++; n--; }
+    for (; n >= 64; d += 64, s += 64, n -= 64) {
+        __m128i a = _mm_loadu_si128((const __m128i*)s);
+        __m128i b = _mm_loadu_si128((const __m128i*)(s + 16));
+        __m128i c = _mm_loadu_si128((const __m128i*)(s + 32));
+        __m128i e = _mm_loadu_si128((const __m128i*)(s + 48));
+        _mm_stream_si128((__m128i*)d, a);
+        _mm_stream_si128((__m128i*)(d + 16), b);
+        _mm_stream_si128((__m128i*)(d + 32), c);
+        _mm_stream_si128((__m128i*)(d + 48), e);
+    }
+    for (; n >= 16; d += 16, s += 16, n -= 16) _mm_stream_si128((__m128i*)d, _mm_loadu_si128((const __m128i*)s));
+    while (n--) *d++ = *s++;
+}
+#endif
+
+// best first for each kind of memory. for the framebuffer vector streaming, or movnti in kernels built
+// without simd, which every amd64 cpu has. for the shadow fast strings when the cpu has them
+static const struct {
+    bool vram;
+    uint32_t needs;
+    term_fill_fn fill;
+    term_copy_fn copy;
+} term_mem_kernels[] = {
+#ifdef CUORETERM_X86_SIMD
+    { true, TERM_CPU_SSE2, term_fill_ntdq, term_copy_ntdq },
+#endif
+#ifdef CUORETERM_X86
+    { true, 0, term_fill_movnti, term_copy_movnti },
+    { false, TERM_CPU_ERMS, term_fill_erms, term_copy_erms },
+#endif
+    { true, 0, term_fill_plain, term_copy_plain },
+    { false, 0, term_fill_plain, term_copy_plain },
+};
 
-    uint32_t px = term->cursor_x * term->font_width;
-    uint32_t py = term->cursor_y * term->font_height;
+#define TERM_MEM_KERNELS (sizeof(term_mem_kernels) / sizeof(term_mem_kernels[0]))
 
-    const uint8_t *glyph = term->font_data + 4 + ((uint8_t)c * term->font_height);
+static void term_pick_mem(struct terminal *term, uint32_t feat) {
+    term->fb_fill = term->mem_fill = 0;
 
-    uint16_t fg16 = (((fg >> 19) & 0x1F) << 11) | (((fg >> 10) & 0x3F) << 5) | ((fg >> 3) & 0x1F);
-    uint8_t fg_gray = ((fg>>16) + ((fg>>8)&0xFF) + (fg&0xFF)) / 3;
+    for (uint32_t i = 0; i < TERM_MEM_KERNELS; i++) {
+        if (term_mem_kernels[i].needs & ~feat) continue;
 
-    for (uint32_t r = 0; r < term->font_height; r++) {
-        uint8_t bits = glyph[r];
-        uint8_t *row_ptr = (uint8_t*)term->fb_addr + (py + r) * term->fb_pitch + px * term->pixel_bytes;
-
-        switch(term->pixel_bytes) {
-            case 4:
-            case 3: {
-                uint8_t r_off = term->r_offset, g_off = term->g_offset, b_off = term->b_offset;
-                for (int col = 0; col < 8; col++, row_ptr += term->pixel_bytes)
-                    if (bits & (1 << (7 - col))) {
-                        row_ptr[r_off] = (uint8_t)((fg >> 16) & 0xFF);
-                        row_ptr[g_off] = (uint8_t)((fg >> 8) & 0xFF);
-                        row_ptr[b_off] = (uint8_t)(fg & 0xFF);
-                    }
-                break;
-            }
-            case 2:
-                for (int col = 0; col < 8; col++, row_ptr += 2)
-                    if (bits & (1 << (7 - col))) *(uint16_t*)row_ptr = fg16;
-                break;
-            case 1:
-                for (int col = 0; col < 8; col++, row_ptr++)
-                    if (bits & (1 << (7 - col))) *row_ptr = fg_gray;
-                break;
+        if (term_mem_kernels[i].vram && !term->fb_fill) {
+            term->fb_fill = term_mem_kernels[i].fill;
+            term->fb_copy = term_mem_kernels[i].copy;
+        } else if (!term_mem_kernels[i].vram && !term->mem_fill) {
+            term->mem_fill = term_mem_kernels[i].fill;
+            term->mem_copy = term_mem_kernels[i].copy;
         }
     }
+}
 
-    term->cursor_x++;
-    if (term->cursor_x >= term->cols) { term->cursor_x = 0; term->cursor_y++; if(term->cursor_y >= term->rows) term_scroll(term); }
+// vram says whether dst is a framebuffer (fb_addr or a head) or the shadow
+static inline void term_fb_fill(struct terminal *term, bool vram, void *dst, uint8_t v, uint32_t n) {
+    if (n < TERM_STREAM_MIN) h_memset(dst, v, n);
+    else if (vram) term->fb_fill(dst, v, n);
+    else term->mem_fill(dst, v, n);
 }
 
-static uint8_t hex_lut[256] = {
-    ['0']=0, ['1']=1, ['2']=2, ['3']=3, ['4']=4,
-    ['5']=5, ['6']=6, ['7']=7, ['8']=8, ['9']=9,
-    ['a']=10,['b']=11,['c']=12,['d']=13,['e']=14,['f']=15,
-    ['A']=10,['B']=11,['C']=12,['D']=13,['E']=14,['F']=15,
+static inline void term_fb_copy(struct terminal *term, bool vram, void *dst, const void *src, uint32_t n) {
+    if (n < TERM_STREAM_MIN) h_memmove(dst, src, n);
+    else if (vram) term->fb_copy(dst, src, n);
+    else term->mem_copy(dst, src, n);
+}
+
+// one native pixel store per size, the only thing that differs between the renderers below.
+// the channel layout is folded into the packed colour beforehand so it never reaches a pixel loop
+#define TERM_STORE4(p, v) (*(uint32_t*)(p) = (v))
+#define TERM_STORE3(p, v) ((p)[0] = (uint8_t)(v), (p)[1] = (uint8_t)((v) >> 8), (p)[2] = (uint8_t)((v) >> 16))
+#define TERM_STORE2(p, v) (*(uint16_t*)(p) = (uint16_t)(v))
+#define TERM_STORE1(p, v) (*(p) = (uint8_t)(v))
+
+struct cuoreterm_pixel_ops {
+    void (*pixel)(uint8_t *p, uint32_t col);
+    void (*fill)(uint8_t *p, uint32_t count, uint32_t col);
+    cuoreterm_glyph_fn glyph;   // scalar references for the simd kernels
+    cuoreterm_opaque_fn opaque;
+    void (*expand)(uint8_t *dst, const uint8_t *bits, uint32_t bit_w, uint32_t w, uint32_t fg, uint32_t bg); // w pixels, past bit_w bg
+};
+
+#define TERM_DEFINE_RENDERER(n)                                                                            \
+static void term_pixel##n(uint8_t *p, uint32_t col) { TERM_STORE##n(p, col); }                            \
+                                                                                                           \
+static void term_fill##n(uint8_t *p, uint32_t count, uint32_t col) {                                       \
+    for (uint32_t i = 0; i < count; i++, p += n) TERM_STORE##n(p, col);                                    \
+}                                                                                                          \
+                                                                                                           \
+static void term_glyph##n(uint8_t *dst, uint32_t pitch, const uint8_t *glyph, uint32_t h, uint32_t col) {  \
+    for (uint32_t r = 0; r < h; r++, dst += pitch) {                                                       \
+        uint8_t bits = glyph[r];                                                                           \
+        for (int x = 0; x < 8; x++)                                                                        \
+            if (bits & (0x80 >> x)) TERM_STORE##n(dst + x * n, col);                                       \
+    }                                                                                                      \
+}                                                                                                          \
+                                                                                                           \
+static void term_opaque##n(uint8_t *dst, uint32_t pitch, const uint8_t *glyph, uint32_t h, uint32_t fg, uint32_t bg) { \
+    for (uint32_t r = 0; r < h; r++, dst += pitch) {                                                       \
+        uint8_t bits = glyph[r];                                                                           \
+        for (int x = 0; x < 8; x++)                                                                        \
+            TERM_STORE##n(dst + x * n, (bits & (0x80 >> x)) ? fg : bg);                                    \
+    }                                                                                                      \
+}                                                                                                          \
+                                                                                                           \
+static void term_expand##n(uint8_t *dst, const uint8_t *bits, uint32_t bit_w, uint32_t w, uint32_t fg, uint32_t bg) { \
+    for (uint32_t x = 0; x < w; x++, dst += n)                                                             \
+        TERM_STORE##n(dst, (x < bit_w && (bits[x >> 3] & (0x80 >> (x & 7)))) ? fg : bg);                   \
+}                                                                                                          \
+                                                                                                           \
+static const struct cuoreterm_pixel_ops term_ops##n = {                                                    \
+    term_pixel##n, term_fill##n, term_glyph##n, term_opaque##n, term_expand##n                             \
 };
 
-static inline uint32_t hex_digit(char c) {
-    return hex_lut[(uint8_t)c];
+TERM_DEFINE_RENDERER(4)
+TERM_DEFINE_RENDERER(3)
+TERM_DEFINE_RENDERER(2)
+TERM_DEFINE_RENDERER(1)
+
+static const struct cuoreterm_pixel_ops *term_pick_ops(uint8_t bytes) {
+    switch(bytes) {
+        case 4: return &term_ops4;
+        case 3: return &term_ops3;
+        case 2: return &term_ops2;
+        case 1: return &term_ops1;
+    }
+    return 0;
 }
 
-static inline uint32_t parse_hex_color(const char *s) {
-    return (hex_lut[(uint8_t)s[0]] << 20) |
-           (hex_lut[(uint8_t)s[1]] << 16) |
-           (hex_lut[(uint8_t)s[2]] << 12) |
-           (hex_lut[(uint8_t)s[3]] << 8)  |
-           (hex_lut[(uint8_t)s[4]] << 4)  |
-            hex_lut[(uint8_t)s[5]];
+// scale an 8 bit channel to size bits, replicating the top bits when the panel is deeper than 8
+static inline uint32_t term_channel(uint32_t c, uint8_t size) {
+    if (size <= 8) return c >> (8 - size);
+    return (c << (size - 8)) | (c >> (16 - size));
 }
 
-static inline void handle_hex_ansi(struct terminal *term, char **p_c) {
-    char *c = *p_c;
-    if (*c++ != '[') return;
+// 0xRRGGBB as it is laid out in one fb pixel
+static inline uint32_t term_pack(const struct cuoreterm_format *f, uint32_t rgb) {
+    uint32_t r = (rgb >> 16) & 0xFF, g = (rgb >> 8) & 0xFF, b = rgb & 0xFF;
 
-    if (c[0] == '0' && c[1] == 'm') {
-        term->fgcol = 0xFFFFFF;
-        *p_c = c + 2;
-        return;
+    if (f->r_shift == f->g_shift && f->g_shift == f->b_shift)
+        return term_channel((r + g + b) / 3, f->r_size) << f->r_shift;
+
+    return (term_channel(r, f->r_size) << f->r_shift) |
+           (term_channel(g, f->g_size) << f->g_shift) |
+           (term_channel(b, f->b_size) << f->b_shift);
+}
+
+// vga colours for the first 16 palette entries (sgr 30-37, 40-47, 90-97 and 100-107)
+static const uint32_t term_ansi_rgb[16] = {
+    0x000000, 0xAA0000, 0x00AA00, 0xAA5500, 0x0000AA, 0xAA00AA, 0x00AAAA, 0xAAAAAA,
+    0x555555, 0xFF5555, 0x55FF55, 0xFFFF55, 0x5555FF, 0xFF55FF, 0x55FFFF, 0xFFFFFF,
+};
+
+// xterm 256 colour index to 0xRRGGBB: 16 vga colours, a 6x6x6 cube, then 24 grays
+static uint32_t term_palette_rgb(uint32_t i) {
+    static const uint8_t level[6] = { 0, 95, 135, 175, 215, 255 };
+
+    if (i < 16) return term_ansi_rgb[i];
+    if (i < 232) {
+        i -= 16;
+        return ((uint32_t)level[i / 36] << 16) | ((uint32_t)level[(i / 6) % 6] << 8) | level[i % 6];
     }
+    return (8 + (i - 232) * 10) * 0x010101;
+}
+
+// pack the palette and the current colours for the fb, colour escapes are then a table lookup
+static void term_build_palette(struct terminal *term) {
+    for (uint32_t i = 0; i < 256; i++) term->palette[i] = term_pack(&term->fmt, term_palette_rgb(i));
+    term->fg_px = term_pack(&term->fmt, term->fgcol);
+    term->bg_px = term_pack(&term->fmt, term->bgcol);
+}
+
+#ifdef CUORETERM_X86_SIMD
+// broadcast the row bits, and with one bit per lane and compare to get a lane mask, then mask store
+// the colour. maskmovdqu is a non temporal store, term_present fences once after a whole write. that
+// suits the framebuffer, which is never read, but a shadow is flushed from straight after, so there the
+// _mem kernels blend into what is already there with an ordinary load and store instead
 
-    if (*c == '#') {
-        term->fgcol = parse_hex_color(c + 1);
-        c += 7;
+__attribute__((target("sse2")))
+static void term_glyph32_sse2(uint8_t *dst, uint32_t pitch, const uint8_t *glyph, uint32_t h, uint32_t col) {
+    const __m128i sel_lo = _mm_set_epi32(0x10, 0x20, 0x40, 0x80);
+    const __m128i sel_hi = _mm_set_epi32(0x01, 0x02, 0x04, 0x08);
+    const __m128i c = _mm_set1_epi32((int)col);
+
+    for (uint32_t r = 0; r < h; r++, dst += pitch) {
+        if (!glyph[r]) continue;
+        __m128i b = _mm_set1_epi32(glyph[r]);
+        _mm_maskmoveu_si128(c, _mm_cmpeq_epi32(_mm_and_si128(b, sel_lo), sel_lo), (char*)dst);
+        _mm_maskmoveu_si128(c, _mm_cmpeq_epi32(_mm_and_si128(b, sel_hi), sel_hi), (char*)dst + 16);
     }
+}
 
-    if (*c == 'm') c++;
-    *p_c = c;
+__attribute__((target("sse2")))
+static void term_glyph32_sse2_mem(uint8_t *dst, uint32_t pitch, const uint8_t *glyph, uint32_t h, uint32_t col) {
+    const __m128i sel_lo = _mm_set_epi32(0x10, 0x20, 0x40, 0x80);
+    const __m128i sel_hi = _mm_set_epi32(0x01, 0x02, 0x04, 0x08);
+    const __m128i c = _mm_set1_epi32((int)col);
+
+    for (uint32_t r = 0; r < h; r++, dst += pitch) {
+        if (!glyph[r]) continue;
+        __m128i b = _mm_set1_epi32(glyph[r]);
+        __m128i lo = _mm_cmpeq_epi32(_mm_and_si128(b, sel_lo), sel_lo);
+        __m128i hi = _mm_cmpeq_epi32(_mm_and_si128(b, sel_hi), sel_hi);
+        __m128i d0 = _mm_loadu_si128((const __m128i*)dst);
+        __m128i d1 = _mm_loadu_si128((const __m128i*)(dst + 16));
+        _mm_storeu_si128((__m128i*)dst, _mm_or_si128(_mm_and_si128(lo, c), _mm_andnot_si128(lo, d0)));
+        _mm_storeu_si128((__m128i*)(dst + 16), _mm_or_si128(_mm_and_si128(hi, c), _mm_andnot_si128(hi, d1)));
+    }
 }
 
-void cuoreterm_write(void *ctx, const char *msg, uint64_t len) {
-    struct terminal *term = (struct terminal *)ctx;
-    char *p_c = (char *)msg;
-    char *end = p_c + len;
+__attribute__((target("sse2")))
+static void term_glyph16_sse2(uint8_t *dst, uint32_t pitch, const uint8_t *glyph, uint32_t h, uint32_t col) {
+    const __m128i sel = _mm_set_epi16(0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, 0x80);
+    const __m128i c = _mm_set1_epi16((short)col);
 
-    while (p_c < end) {
-        char c = *p_c++;
+    for (uint32_t r = 0; r < h; r++, dst += pitch) {
+        if (!glyph[r]) continue;
+        __m128i b = _mm_set1_epi16(glyph[r]);
+        _mm_maskmoveu_si128(c, _mm_cmpeq_epi16(_mm_and_si128(b, sel), sel), (char*)dst);
+    }
+}
 
-        if (c == '\n') {
-            term->cursor_x = 0;
-            term->cursor_y++;
-            if (term->cursor_y >= term->rows) term_scroll(term);
-        }
-        else if (c == '\b') {
-            if (term->cursor_x == 0) {
-                if (term->cursor_y == 0) continue;
-                term->cursor_y--;
-                term->cursor_x = term->cols - 1;
-            } else {
-                term->cursor_x--;
-            }
+__attribute__((target("sse2")))
+static void term_glyph16_sse2_mem(uint8_t *dst, uint32_t pitch, const uint8_t *glyph, uint32_t h, uint32_t col) {
+    const __m128i sel = _mm_set_epi16(0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, 0x80);
+    const __m128i c = _mm_set1_epi16((short)col);
 
-            uint32_t px = term->cursor_x * term->font_width;
-            uint32_t py = term->cursor_y * term->font_height;
+    for (uint32_t r = 0; r < h; r++, dst += pitch) {
+        if (!glyph[r]) continue;
+        __m128i m = _mm_cmpeq_epi16(_mm_and_si128(_mm_set1_epi16(glyph[r]), sel), sel);
+        __m128i d = _mm_loadu_si128((const __m128i*)dst);
+        _mm_storeu_si128((__m128i*)dst, _mm_or_si128(_mm_and_si128(m, c), _mm_andnot_si128(m, d)));
+    }
+}
 
-            uint8_t *start = (uint8_t *)term->fb_addr + py * term->fb_pitch + px * (term->fb_bpp / 8);
-            for (uint32_t r = 0; r < term->font_height; r++) {
-                h_memset(start + r * term->fb_pitch, 0x00, term->font_width * (term->fb_bpp / 8));
-            }
-        }
-        else if (c == '\x1b') {
-            if (p_c < end && *p_c == '[')
-                handle_hex_ansi(term, &p_c);
-        }
-        else {
-            cuoreterm_draw_char(term, c, term->fgcol);
+// opaque rows select fg or bg per lane with the same masks and store the whole row, no read of dst
+__attribute__((target("sse2")))
+static void term_opaque32_sse2(uint8_t *dst, uint32_t pitch, const uint8_t *glyph, uint32_t h, uint32_t fg, uint32_t bg) {
+    const __m128i sel_lo = _mm_set_epi32(0x10, 0x20, 0x40, 0x80);
+    const __m128i sel_hi = _mm_set_epi32(0x01, 0x02, 0x04, 0x08);
+    const __m128i f = _mm_set1_epi32((int)fg);
+    const __m128i k = _mm_set1_epi32((int)bg);
+
+    for (uint32_t r = 0; r < h; r++, dst += pitch) {
+        __m128i b = _mm_set1_epi32(glyph[r]);
+        __m128i lo = _mm_cmpeq_epi32(_mm_and_si128(b, sel_lo), sel_lo);
+        __m128i hi = _mm_cmpeq_epi32(_mm_and_si128(b, sel_hi), sel_hi);
+        _mm_storeu_si128((__m128i*)dst, _mm_or_si128(_mm_and_si128(lo, f), _mm_andnot_si128(lo, k)));
+        _mm_storeu_si128((__m128i*)(dst + 16), _mm_or_si128(_mm_and_si128(hi, f), _mm_andnot_si128(hi, k)));
+    }
+}
+
+__attribute__((target("sse2")))
+static void term_opaque16_sse2(uint8_t *dst, uint32_t pitch, const uint8_t *glyph, uint32_t h, uint32_t fg, uint32_t bg) {
+    const __m128i sel = _mm_set_epi16(0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, 0x80);
+    const __m128i f = _mm_set1_epi16((short)fg);
+    const __m128i k = _mm_set1_epi16((short)bg);
+
+    for (uint32_t r = 0; r < h; r++, dst += pitch) {
+        __m128i m = _mm_cmpeq_epi16(_mm_and_si128(_mm_set1_epi16(glyph[r]), sel), sel);
+        _mm_storeu_si128((__m128i*)dst, _mm_or_si128(_mm_and_si128(m, f), _mm_andnot_si128(m, k)));
+    }
+}
+
+__attribute__((target("avx2")))
+static void term_opaque32_avx2(uint8_t *dst, uint32_t pitch, const uint8_t *glyph, uint32_t h, uint32_t fg, uint32_t bg) {
+    const __m256i sel = _mm256_set_epi32(0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, 0x80);
+    const __m256i f = _mm256_set1_epi32((int)fg);
+    const __m256i k = _mm256_set1_epi32((int)bg);
+
+    for (uint32_t r = 0; r < h; r++, dst += pitch) {
+        __m256i m = _mm256_cmpeq_epi32(_mm256_and_si256(_mm256_set1_epi32(glyph[r]), sel), sel);
+        _mm256_storeu_si256((__m256i*)dst, _mm256_blendv_epi8(k, f, m));
+    }
+}
+
+// vpmaskmovd is an ordinary store, one per row. a 16bpp row is only one xmm so it stays on sse2
+__attribute__((target("avx2")))
+static void term_glyph32_avx2(uint8_t *dst, uint32_t pitch, const uint8_t *glyph, uint32_t h, uint32_t col) {
+    const __m256i sel = _mm256_set_epi32(0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, 0x80);
+    const __m256i c = _mm256_set1_epi32((int)col);
+
+    for (uint32_t r = 0; r < h; r++, dst += pitch) {
+        if (!glyph[r]) continue;
+        __m256i b = _mm256_set1_epi32(glyph[r]);
+        _mm256_maskstore_epi32((int*)dst, _mm256_cmpeq_epi32(_mm256_and_si256(b, sel), sel), c);
+    }
+}
+#endif
+
+// where a kernel may draw, TERM_DRAW_ANY for both the framebuffer and a shadow
+#define TERM_DRAW_ANY    0
+#define TERM_DRAW_VRAM   1
+#define TERM_DRAW_SHADOW 2
+
+// best first, the scalar kernel of each size is the fallback
+static const struct {
+    uint8_t bytes;
+    uint8_t draw;
+    uint32_t needs;
+    cuoreterm_glyph_fn fn;
+    cuoreterm_opaque_fn opaque;
+} term_glyph_kernels[] = {
+#ifdef CUORETERM_X86_SIMD
+    { 4, TERM_DRAW_ANY, TERM_CPU_AVX2, term_glyph32_avx2, term_opaque32_avx2 },
+    { 4, TERM_DRAW_VRAM, TERM_CPU_SSE2, term_glyph32_sse2, term_opaque32_sse2 },
+    { 4, TERM_DRAW_SHADOW, TERM_CPU_SSE2, term_glyph32_sse2_mem, term_opaque32_sse2 },
+    { 2, TERM_DRAW_VRAM, TERM_CPU_SSE2, term_glyph16_sse2, term_opaque16_sse2 },
+    { 2, TERM_DRAW_SHADOW, TERM_CPU_SSE2, term_glyph16_sse2_mem, term_opaque16_sse2 },
+#endif
+    { 4, TERM_DRAW_ANY, 0, term_glyph4, term_opaque4 },
+    { 3, TERM_DRAW_ANY, 0, term_glyph3, term_opaque3 },
+    { 2, TERM_DRAW_ANY, 0, term_glyph2, term_opaque2 },
+    { 1, TERM_DRAW_ANY, 0, term_glyph1, term_opaque1 },
+};
+
+#define TERM_GLYPH_KERNELS (sizeof(term_glyph_kernels) / sizeof(term_glyph_kernels[0]))
+
+// set glyph_blit and opaque_blit to the best pair for pixel_bytes on this cpu and what is drawn into
+static void term_pick_glyph_kernels(struct terminal *term, uint32_t feat) {
+    uint8_t skip = term->shadow_addr ? TERM_DRAW_VRAM : TERM_DRAW_SHADOW;
+    term->glyph_blit = 0;
+    term->opaque_blit = 0;
+
+    for (uint32_t i = 0; i < TERM_GLYPH_KERNELS; i++) {
+        if (term_glyph_kernels[i].bytes == term->pixel_bytes && term_glyph_kernels[i].draw != skip &&
+            (term_glyph_kernels[i].needs & ~feat) == 0) {
+            term->glyph_blit = term_glyph_kernels[i].fn;
+            term->opaque_blit = term_glyph_kernels[i].opaque;
+            return;
         }
     }
 }
 
-void cuoreterm_set_font(struct terminal *term, const uint8_t *font, uint32_t font_w, uint32_t font_h) {
-    term->font_data   = font;
-    term->font_width  = font_w;
-    term->font_height = font_h;
-    term->cols = term->fb_width / font_w;
-    term->rows = term->fb_height / font_h;
+// grow the pending flush rect to cover w x h pixels at x, y
+static inline void term_damage(struct terminal *term, uint32_t x, uint32_t y, uint32_t w, uint32_t h) {
+    if (!term->shadow_addr) return;
+
+    if (x < term->dirty_x0) term->dirty_x0 = x;
+    if (y < term->dirty_y0) term->dirty_y0 = y;
+    if (x + w > term->dirty_x1) term->dirty_x1 = x + w;
+    if (y + h > term->dirty_y1) term->dirty_y1 = y + h;
 }
 
-void cuoreterm_clear(struct terminal *term) {
-    h_memset(term->fb_addr, 0x00, term->fb_pitch * term->fb_height);
-    term->cursor_x = 0;
-    term->cursor_y = 0;
+static inline bool term_same_format(const struct cuoreterm_format *a, const struct cuoreterm_format *b) {
+    return (a->bpp + 7) / 8 == (b->bpp + 7) / 8 &&
+           a->r_size == b->r_size && a->r_shift == b->r_shift &&
+           a->g_size == b->g_size && a->g_shift == b->g_shift &&
+           a->b_size == b->b_size && a->b_shift == b->b_shift;
+}
+
+static inline uint32_t term_load(const uint8_t *p, uint8_t bytes) {
+    switch(bytes) {
+        case 4: return *(const uint32_t*)p;
+        case 3: return p[0] | (p[1] << 8) | ((uint32_t)p[2] << 16);
+        case 2: return *(const uint16_t*)p;
+    }
+    return *p;
 }
 
+static inline void term_store(uint8_t *p, uint8_t bytes, uint32_t v) {
+    switch(bytes) {
+        case 4: TERM_STORE4(p, v); break;
+        case 3: TERM_STORE3(p, v); break;
+        case 2: TERM_STORE2(p, v); break;
+        default: TERM_STORE1(p, v); break;
+    }
+}
+
+// one channel of a packed pixel back to 8 bits
+static inline uint32_t term_unchannel(uint32_t v, uint8_t size, uint8_t shift) {
+    uint32_t max = (1u << size) - 1;
+    uint32_t c = (v >> shift) & max;
+    return size >= 8 ? c >> (size - 8) : (c * 255 + max / 2) / max;
+}
+
+// packed pixel back to 0xRRGGBB
+static inline uint32_t term_unpack(const struct cuoreterm_format *f, uint32_t v) {
+    uint32_t r = term_unchannel(v, f->r_size, f->r_shift);
+    if (f->r_shift == f->g_shift && f->g_shift == f->b_shift) return r * 0x010101;
+
+    return (r << 16) | (term_unchannel(v, f->g_size, f->g_shift) << 8) | term_unchannel(v, f->b_size, f->b_shift);
+}
+
+// n pixels from the shadow format to a head's. text is long stretches of one colour, so only pixels that
+// differ from the one before get converted
+static void term_convert_row(uint8_t *dst, const struct cuoreterm_head *h, const uint8_t *src,
+                             const struct cuoreterm_format *sf, uint8_t sb, uint32_t n) {
+    uint32_t in = term_load(src, sb);
+    uint32_t out = term_pack(&h->fmt, term_unpack(sf, in));
+
+    for (uint32_t i = 0; i < n; i++, src += sb, dst += h->pixel_bytes) {
+        uint32_t v = term_load(src, sb);
+        if (v != in) { in = v; out = term_pack(&h->fmt, term_unpack(sf, v)); }
+        term_store(dst, h->pixel_bytes, out);
+    }
+}
+
+// the dirty rect to one mirror, a plain streaming copy when it has the shadow's pixel layout
+static void term_flush_head(struct terminal *term, const struct cuoreterm_head *h) {
+    if (term->pane_x >= h->width || term->pane_y >= h->height) return;
+
+    uint32_t hw = h->width - term->pane_x, hh = h->height - term->pane_y; // of the head, from the pane's corner
+    uint32_t x1 = term->dirty_x1 < hw ? term->dirty_x1 : hw;
+    uint32_t y1 = term->dirty_y1 < hh ? term->dirty_y1 : hh;
+    if (x1 > term->fb_width) x1 = term->fb_width;
+    if (y1 > term->fb_height) y1 = term->fb_height;
+    if (term->dirty_x0 >= x1 || term->dirty_y0 >= y1) return;
+
+    uint32_t n = x1 - term->dirty_x0;
+    bool same = term_same_format(&term->fmt, &h->fmt);
+    uint8_t *corner = (uint8_t*)h->addr + term->pane_y * h->pitch + term->pane_x * h->pixel_bytes;
+
+    for (uint32_t y = term->dirty_y0; y < y1; y++) {
+        const uint8_t *src = (const uint8_t*)term->shadow_addr + y * term->fb_pitch + term->dirty_x0 * term->pixel_bytes;
+        uint8_t *dst = corner + y * h->pitch + term->dirty_x0 * h->pixel_bytes;
+
+        if (same) term_fb_copy(term, true, dst, src, n * h->pixel_bytes);
+        else term_convert_row(dst, h, src, &term->fmt, term->pixel_bytes, n);
+    }
+    TERM_STAT_ADD(term, fb_written, (uint64_t)n * h->pixel_bytes * (y1 - term->dirty_y0));
+}
+
+// copy the dirty rect from the shadow to the framebuffer and every mirror, vram is only ever written
+static void term_flush(struct terminal *term) {
+    if (!term->shadow_addr || term->dirty_x0 >= term->dirty_x1) return;
+
+    uint32_t x1 = term->dirty_x1 < term->fb_width ? term->dirty_x1 : term->fb_width;
+    uint32_t y1 = term->dirty_y1 < term->fb_height ? term->dirty_y1 : term->fb_height;
+    uint32_t off = term->dirty_x0 * term->pixel_bytes;
+    uint32_t span = x1 * term->pixel_bytes - off;
+
+    for (uint32_t y = term->dirty_y0; y < y1; y++) {
+        uint32_t row = y * term->fb_pitch + off;
+        term_fb_copy(term, true, (uint8_t*)term->fb_addr + row, (uint8_t*)term->shadow_addr + row, span);
+    }
+    TERM_STAT_ADD(term, fb_written, (uint64_t)span * (y1 - term->dirty_y0));
+
+    for (uint32_t i = 0; i < term->nheads; i++) term_flush_head(term, &term->heads[i]);
+
+    term->dirty_x0 = term->dirty_y0 = UINT32_MAX;
+    term->dirty_x1 = term->dirty_y1 = 0;
+}
+
+void cuoreterm_init(
+    struct terminal *term,
+    void *fb_addr,
+    uint32_t fb_width,
+    uint32_t fb_height,
+    uint32_t fb_pitch,
+    uint32_t fb_bpp,
+    const uint8_t *font,
+    uint32_t font_w,
+    uint32_t font_h
+) {
+    cuoreterm_init_shadow(term, fb_addr, fb_width, fb_height, fb_pitch, fb_bpp, 0, font, font_w, font_h);
+}
+
+void cuoreterm_init_shadow(
+    struct terminal *term,
+    void *fb_addr,
+    uint32_t fb_width,
+    uint32_t fb_height,
+    uint32_t fb_pitch,
+    uint32_t fb_bpp,
+    void *shadow,
+    const uint8_t *font,
+    uint32_t font_w,
+    uint32_t font_h
+) {
+    term->fb_addr   = fb_addr;
+    term->fb_width  = fb_width;
+    term->fb_height = fb_height;
+    term->fb_pitch  = fb_pitch;
+    term->fb_bpp    = fb_bpp;
+
+    term->shadow_addr = shadow;
+    term->draw_addr   = shadow ? shadow : fb_addr;
+    term->screen_fb = fb_addr;
+    term->screen_shadow = shadow;
+    term->screen_width = fb_width;
+    term->screen_height = fb_height;
+    term->pane_x = term->pane_y = 0;
+    term->dirty_x0 = term->dirty_y0 = UINT32_MAX;
+    term->dirty_x1 = term->dirty_y1 = 0;
+    term->nheads = 0;
+
+    term->deferred = false;
+    term->measuring = false;
+    term->measure_abort = false;
+    term->scroll_ahead = 0;
+
+    term->cells = 0;
+    term->grid_cap = 0;
+    term->prev = 0;
+    term->prev_cap = 0;
+    term->gcache = 0;
+    term->gcache_size = 0;
+    term->sb = 0;
+    term->sb_size = 0;
+    term->sb_view = 0;
+    term->view_redraw = false;
+    term->run_tasks = 0;
+    term->tasks = 0;
+    term->font_map_buf = term->font_low;
+    term->font_map_cap = 256;
+    term->font_compiled = 0;
+    term->font_pixels = 0;
+    term->scale = 1;
+    term->atlas = 0;
+    term->atlas_size = 0;
+
+    term->fgcol = 0xFFFFFF;
+    term->bgcol = 0x000000;
+    term->opaque = false;
+
+    term->cursor_x = 0;
+    term->cursor_y = 0;
+    h_memset(&term->vt, 0x00, sizeof(term->vt));
+#ifdef CUORETERM_STATS
+    h_memset(&term->stats, 0x00, sizeof(term->stats));
+#endif
+
+    // best guess from bpp alone, cuoreterm_set_format fixes it up with the real masks
+    struct cuoreterm_format fmt = { (uint8_t)fb_bpp, 8, 0, 8, 0, 8, 0 };
+    switch(fb_bpp) {
+        case 32: fmt = (struct cuoreterm_format){ 32, 8, 16, 8, 8, 8, 0 }; break; // ARGB
+        case 24: fmt = (struct cuoreterm_format){ 24, 8, 0, 8, 8, 8, 16 }; break; // RGB
+        case 16: fmt = (struct cuoreterm_format){ 16, 5, 11, 6, 5, 5, 0 }; break; // RGB565
+        case 15: fmt = (struct cuoreterm_format){ 15, 5, 10, 5, 5, 5, 0 }; break; // RGB555
+        case 8:  break; // grayscale
+    }
+    term->fmt = fmt;
+    term_build_palette(term);
+    term->pixel_bytes = (fb_bpp + 7) / 8;
+    term->ops = term_pick_ops(term->pixel_bytes);
+    term_pick_glyph_kernels(term, term_cpu_features());
+    term_pick_mem(term, term_cpu_features());
+
+    // NULL leaves the font to a cuoreterm_set_compiled_font straight after, until then there are no
+    // cells and writes draw nothing
+    term->font_data = 0;
+    term->font_bits = 0;
+    term->font_table = 0;
+    term->font_end = 0;
+    term->font_table_utf8 = false;
+    term->font_glyph_w = term->font_glyph_h = term->font_stride = term->font_bytes = 0;
+    term->cell_w = term->cell_h = 0;
+    term->font_glyphs = 0;
+    term->glyph_count = term->glyph_stride = term->glyph_bytes = 0;
+    term->glyph_w = term->glyph_h = 0;
+    term->font_map = term->font_map_buf;
+    term->font_map_size = 0;
+    term->font_missing = 0;
+    term->font_width = term->font_height = 0;
+    term->cols = term->rows = 0;
+    term->scroll_top = term->scroll_bottom = 0;
+    if (font) cuoreterm_set_font(term, font, font_w, font_h);
+}
+
+static inline struct cuoreterm_cell *term_grid_row(struct terminal *term, uint32_t y) {
+    uint32_t idx = term->grid_head + y;
+    if (idx >= term->rows) idx -= term->rows;
+    return term->cells + idx * term->cols;
+}
+
+static inline void term_grid_dirty(struct terminal *term, uint32_t y0, uint32_t y1) {
+    if (y0 < term->grid_dirty0) term->grid_dirty0 = y0;
+    if (y1 > term->grid_dirty1) term->grid_dirty1 = y1;
+
+    for (uint32_t y = y0; y < y1 && y < CUORETERM_DIRTY_ROWS; y++)
+        term->grid_dirty_bits[y >> 6] |= 1ull << (y & 63);
+}
+
+static inline bool term_grid_row_dirty(const struct terminal *term, uint32_t y) {
+    return y >= CUORETERM_DIRTY_ROWS || (term->grid_dirty_bits[y >> 6] & (1ull << (y & 63)));
+}
+
+// what is on screen is unknown, every cell compares as changed
+static inline void term_prev_forget(struct terminal *term, uint32_t y0, uint32_t y1) {
+    if (term->prev && y0 < y1)
+        h_memset(term->prev + y0 * term->cols, 0xFF, (y1 - y0) * term->cols * sizeof(struct cuoreterm_cell));
+}
+
+static void term_grid_reset(struct terminal *term) {
+    if (term->cells && term->cols * term->rows > term->grid_cap)
+        term->rows = term->cols ? term->grid_cap / term->cols : 0;
+
+    // a new font, scale or pane can need more cells than the caller's copy has, drawing goes back to rows
+    if (term->prev && term->cols * term->rows > term->prev_cap) term->prev = 0;
+    if (!term->cells) return;
+
+    h_memset(term->cells, 0x00, term->cols * term->rows * sizeof(struct cuoreterm_cell));
+    h_memset(term->grid_dirty_bits, 0x00, sizeof(term->grid_dirty_bits));
+    term->grid_head = 0;
+    term->grid_dirty0 = UINT32_MAX;
+    term->grid_dirty1 = 0;
+    term_prev_forget(term, 0, term->rows);
+}
+
+// a scrollback record: header, colour runs, one byte per cell padded to 4 (four bytes per cell for lines
+// with codepoints past 0xff, TERM_SB_WIDE in runs), then the record size again so the ring can be walked
+// backwards. a header with TERM_SB_PAD fills the end of the ring before a wrap
+struct term_sb_line {
+    uint32_t size;
+    uint16_t chars, runs;
+};
+
+struct term_sb_run {
+    uint32_t count;
+    uint32_t fg, bg;
+};
+
+#define TERM_SB_PAD  (1u << 31)
+#define TERM_SB_WIDE (1u << 15)
+
+static void term_sb_reset(struct terminal *term) {
+    term->sb_head = term->sb_tail = 0;
+    term->sb_used = term->sb_lines = 0;
+    term->sb_wrap = term->sb_size;
+    term->sb_last = 0;
+    term->sb_find_back = 0;
+    if (term->sb_view) term->view_redraw = true;
+    term->sb_view = 0;
+}
+
+static void term_sb_evict(struct terminal *term) {
+    uint32_t size = *(uint32_t*)(term->sb + term->sb_tail);
+
+    if (!(size & TERM_SB_PAD)) {
+        term->sb_lines--;
+        if (term->sb_find_back > term->sb_lines) term->sb_find_back = 0;
+        if (term->sb_view > term->sb_lines) { term->sb_view = term->sb_lines; term->view_redraw = true; }
+    }
+
+    size &= ~TERM_SB_PAD;
+    term->sb_used -= size;
+    term->sb_tail += size;
+    if (term->sb_tail == term->sb_size) term->sb_tail = 0;
+}
+
+static inline bool term_sb_blank(const struct cuoreterm_cell *c) {
+    return (c->ch == 0 || c->ch == ' ') && c->bg == 0;
+}
+
+// append a grid row about to scroll off, cost is one pass to size it and one to copy it
+static void term_sb_push(struct terminal *term, const struct cuoreterm_cell *row) {
+    uint32_t n = term->cols;
+    while (n && term_sb_blank(&row[n - 1])) n--;
+
+    uint32_t runs = 0;
+    bool wide = false;
+    for (uint32_t x = 0; x < n; x++) {
+        if (x == 0 || row[x].fg != row[x - 1].fg || row[x].bg != row[x - 1].bg) runs++;
+        if (row[x].ch > 0xFF) wide = true;
+    }
+
+    uint32_t need = sizeof(struct term_sb_line) + runs * sizeof(struct term_sb_run) + (wide ? n * 4 : (n + 3) & ~3u) + 4;
+    if (need > term->sb_size) return;
+
+    // records never wrap, pad out the end of the ring instead
+    uint32_t pad = term->sb_head + need > term->sb_size ? term->sb_size - term->sb_head : 0;
+    while (term->sb_used && term->sb_used + pad + need > term->sb_size) term_sb_evict(term);
+    if (!term->sb_used) term->sb_head = term->sb_tail = 0, pad = 0;
+
+    if (pad) {
+        *(uint32_t*)(term->sb + term->sb_head) = TERM_SB_PAD | pad;
+        term->sb_wrap = term->sb_head;
+        term->sb_used += pad;
+        term->sb_head = 0;
+    }
+
+    uint8_t *rec = term->sb + term->sb_head;
+    struct term_sb_line *line = (struct term_sb_line*)rec;
+    struct term_sb_run *run = (struct term_sb_run*)(line + 1);
+    uint8_t *chars = (uint8_t*)(run + runs);
+
+    line->size = need;
+    line->chars = (uint16_t)n;
+    line->runs = (uint16_t)(runs | (wide ? TERM_SB_WIDE : 0));
+
+    for (uint32_t x = 0; x < n; x++) {
+        if (x == 0 || row[x].fg != row[x - 1].fg || row[x].bg != row[x - 1].bg)
+            *run++ = (struct term_sb_run){ 0, row[x].fg, row[x].bg };
+        run[-1].count++;
+        if (wide) ((uint32_t*)chars)[x] = row[x].ch;
+        else chars[x] = (uint8_t)row[x].ch;
+    }
+    *(uint32_t*)(rec + need - 4) = need;
+
+    term->sb_last = term->sb_head;
+    term->sb_head += need;
+    if (term->sb_head == term->sb_size) { term->sb_wrap = term->sb_size; term->sb_head = 0; }
+    term->sb_used += need;
+    term->sb_lines++;
+    if (term->sb_find_back) term->sb_find_back++;
+
+    // keep the view on the same lines while new ones arrive
+    if (term->sb_view && term->sb_view < term->sb_lines) term->sb_view++;
+}
+
+// record of the line back lines from the newest (1 is the newest), walking from the newest record or
+// the last one looked up, whichever is closer. consecutive rows of a view are one step apart
+static const struct term_sb_line *term_sb_find(struct terminal *term, uint32_t back) {
+    uint32_t off = term->sb_last, at = 1;
+
+    uint32_t cached = term->sb_find_back;
+    if (cached && (cached > back ? cached - back : back - cached) < back - 1) { off = term->sb_find_off; at = cached; }
+
+    for (; at < back; at++) {
+        uint32_t end = off ? off : term->sb_wrap;
+        off = end - *(uint32_t*)(term->sb + end - 4);
+    }
+    for (; at > back; at--) {
+        off += *(uint32_t*)(term->sb + off);
+        if (off == term->sb_size || (*(uint32_t*)(term->sb + off) & TERM_SB_PAD)) off = 0;
+    }
+
+    term->sb_find_off = off;
+    term->sb_find_back = back;
+    return (const struct term_sb_line*)(term->sb + off);
+}
+
+static inline bool term_region_full(const struct terminal *term) {
+    return term->scroll_top == 0 && term->scroll_bottom == term->rows;
+}
+
+// the whole screen is the scroll region again, and the cursor back on it
+static void term_region_reset(struct terminal *term) {
+    term->scroll_top = 0;
+    term->scroll_bottom = term->rows;
+    if (term->cursor_y >= term->rows) term->cursor_y = term->rows ? term->rows - 1 : 0;
+    if (term->cursor_x >= term->cols) term->cursor_x = 0;
+}
+
+// bytes of a pane row worth touching, the whole pitch when it is as wide as the screen
+static inline uint32_t term_pane_span(const struct terminal *term) {
+    return term->pane_x == 0 && term->fb_width == term->screen_width ? term->fb_pitch : term->fb_width * term->pixel_bytes;
+}
+
+// n pixel rows of span bytes at dst, one fill when the pane spans the pitch
+static void term_fill_rect(struct terminal *term, bool vram, uint8_t *dst, uint32_t pitch, uint32_t span, uint32_t n) {
+    if (span == pitch) { term_fb_fill(term, vram, dst, 0x00, pitch * n); return; }
+    for (uint32_t y = 0; y < n; y++) term_fb_fill(term, vram, dst + y * pitch, 0x00, span);
+}
+
+// move text rows top up to bottom up by nrows, the rest of the screen stays put. does not touch the cursor
+static void term_scroll_rows(struct terminal *term, uint32_t top, uint32_t bottom, uint32_t nrows) {
+    if (nrows > bottom - top) nrows = bottom - top;
+
+    TERM_STAT_START(t0);
+    TERM_STAT_ADD(term, scrolls, 1);
+    TERM_STAT_ADD(term, scroll_rows, nrows);
+
+    if (term->cells) {
+        uint32_t row_cells = term->cols * sizeof(struct cuoreterm_cell);
+
+        // like xterm, only a region at the top of the screen feeds the scrollback
+        if (term->sb && top == 0)
+            for (uint32_t y = 0; y < nrows; y++) term_sb_push(term, term_grid_row(term, y));
+
+        if (top == 0 && bottom == term->rows) {
+            // recycle the top rows as the new bottom rows, no pixels move until the next present
+            for (uint32_t y = 0; y < nrows; y++) h_memset(term_grid_row(term, y), 0x00, row_cells);
+            term->grid_head = (term->grid_head + nrows) % term->rows;
+        } else {
+            // a region moves its own rows, with prev only cells that differ afterwards get drawn
+            for (uint32_t y = top; y + nrows < bottom; y++)
+                h_memmove(term_grid_row(term, y), term_grid_row(term, y + nrows), row_cells);
+            for (uint32_t y = bottom - nrows; y < bottom; y++) h_memset(term_grid_row(term, y), 0x00, row_cells);
+        }
+        term_grid_dirty(term, top, bottom);
+        TERM_STAT_CYCLES(term, cycles_scroll, t0);
+        return;
+    }
+
+    // pixel rows of the region, the full screen one takes the part row below the text along
+    uint32_t y0 = top * term->font_height;
+    uint32_t y1 = bottom == term->rows ? term->fb_height : bottom * term->font_height;
+    uint32_t gone = term->font_height * nrows, kept = y1 - y0 - gone;
+    uint32_t pitch = term->fb_pitch, span = term_pane_span(term);
+    uint8_t *fb = (uint8_t*)term->draw_addr + y0 * pitch;
+
+    // in shadow mode this memmove stays in system ram and the region gets flushed later. a pane narrower
+    // than the pitch goes row by row so its neighbours stay put
+    bool vram = !term->shadow_addr;
+    if (span == pitch) {
+        term_fb_copy(term, vram, fb, fb + gone * pitch, kept * pitch);
+    } else {
+        for (uint32_t y = 0; y < kept; y++) term_fb_copy(term, vram, fb + y * pitch, fb + (y + gone) * pitch, span);
+    }
+    term_fill_rect(term, vram, fb + kept * pitch, pitch, span, gone);
+    term_damage(term, 0, y0, term->fb_width, y1 - y0);
+
+    if (!term->shadow_addr) TERM_STAT_ADD(term, fb_read, (uint64_t)kept * span);
+    TERM_STAT_DRAWN(term, (uint64_t)(kept + gone) * span);
+    TERM_STAT_CYCLES(term, cycles_scroll, t0);
+}
+
+// the cursor ran off the bottom of the scroll region. a dry run only counts it, and a write that already
+// scrolled by the total up front only keeps the cursor where it is. a region short of the whole screen
+// can't be scrolled ahead since the rows around it stay, the dry run gives up on it
+static void term_scroll(struct terminal *term) {
+    uint32_t nrows = 1;
+
+    if (term->measuring) {
+        if (term_region_full(term)) term->scroll_ahead += nrows;
+        else term->measure_abort = true;
+    } else if (term->scroll_ahead >= nrows) {
+        term->scroll_ahead -= nrows;
+    } else {
+        term_scroll_rows(term, term->scroll_top, term->scroll_bottom, nrows);
+    }
+}
+
+// below the scroll region the cursor stops at the last row without scrolling
+static inline void term_newline(struct terminal *term) {
+    term->cursor_x = 0;
+    if (term->cursor_y + 1 == term->scroll_bottom) term_scroll(term);
+    else if (term->cursor_y + 1 < term->rows) term->cursor_y++;
+}
+
+// whether the cursor row is still on screen once the scroll done up front is counted, and which row
+static inline bool term_cursor_row(struct terminal *term, uint32_t *row) {
+    if (term->measuring || term->cursor_y < term->scroll_ahead) return false;
+    *row = term->cursor_y - term->scroll_ahead;
+    return true;
+}
+
+static inline void h_copy_row(uint8_t *d, const uint8_t *s, uint32_t n) {
+    while (n >= 8) { *(uint64_t*)d = *(const uint64_t*)s; d += 8; s += 8; n -= 8; }
+    while (n >= 4) { *(uint32_t*)d = *(const uint32_t*)s; d += 4; s += 4; n -= 4; }
+    while (n--) *d++ = *s++;
+}
+
+static void term_gcache_reset(struct terminal *term) {
+    uint32_t slot = cuoreterm_glyph_cache_slot_size(term);
+
+    term->gcache_slots = term->gcache && term->ops && slot ? term->gcache_size / slot : 0;
+    if (term->gcache_slots > CUORETERM_GLYPH_CACHE_SLOTS) term->gcache_slots = CUORETERM_GLYPH_CACHE_SLOTS;
+    term->gcache_used = 0;
+    term->gcache_next = 0;
+    term->gcache_last = 0;
+}
+
+// find or make the slot for packed fg on bg, slot 0 is never evicted so the first pair (normally the default) stays hot
+static uint32_t term_gcache_slot(struct terminal *term, uint32_t fg, uint32_t bg) {
+    uint32_t s = term->gcache_last;
+    if (s < term->gcache_used && term->gcache_fg[s] == fg && term->gcache_bg[s] == bg) return s;
+
+    for (s = 0; s < term->gcache_used; s++)
+        if (term->gcache_fg[s] == fg && term->gcache_bg[s] == bg) { term->gcache_last = s; return s; }
+
+    if (term->gcache_used < term->gcache_slots) {
+        s = term->gcache_used++;
+    } else {
+        s = term->gcache_next;
+        if (s == 0) s = term->gcache_slots > 1 ? 1 : 0;
+        term->gcache_next = (s + 1 < term->gcache_slots) ? s + 1 : 0;
+    }
+
+    term->gcache_fg[s] = fg;
+    term->gcache_bg[s] = bg;
+    h_memset(term->gcache_built[s], 0x00, sizeof(term->gcache_built[s]));
+    term->gcache_last = s;
+    return s;
+}
+
+// pixels of glyph g (below CUORETERM_GLYPH_CACHE_GLYPHS) in packed fg on bg, expanding it into the
+// cache the first time it is asked for. whole cells, rows past the glyph are bg
+static const uint8_t *term_gcache_glyph(struct terminal *term, uint32_t g, uint32_t fg, uint32_t bg) {
+    uint32_t s = term_gcache_slot(term, fg, bg);
+    uint32_t row_bytes = term->font_width * term->pixel_bytes;
+    uint8_t *out = term->gcache + s * cuoreterm_glyph_cache_slot_size(term) + g * term->font_height * row_bytes;
+
+    if (term->gcache_built[s][g >> 5] & (1u << (g & 31))) return out;
+
+    const uint8_t *glyph = term->font_glyphs + g * term->glyph_bytes;
+    for (uint32_t r = 0; r < term->font_height; r++) {
+        bool in = r < term->glyph_h;
+        term->ops->expand(out + r * row_bytes, in ? glyph + r * term->glyph_stride : glyph, in ? term->glyph_w : 0,
+                          term->font_width, fg, bg);
+    }
+
+    term->gcache_built[s][g >> 5] |= 1u << (g & 31);
+    return out;
+}
+
+#ifndef CUORETERM_RUN_MAX
+#define CUORETERM_RUN_MAX 64 // glyphs rendered per scanline sweep, bounds the stack used for glyph pointers
+#endif
+
+// the glyph codepoint cp is drawn with, one table lookup
+static inline uint32_t term_glyph_index(const struct terminal *term, uint32_t cp) {
+    return cp < term->font_map_size ? term->font_map[cp] : term->font_missing;
+}
+
+// whether the compiled font's own pixels are packed fg on bg, only taken where drawing is opaque anyway
+static inline bool term_font_pixels_ok(const struct terminal *term, uint32_t fg, uint32_t bg) {
+    return term->font_pixels && fg == term->font_pixels_fg && bg == term->font_pixels_bg &&
+           (term->opaque || term->cells || term->gcache_slots);
+}
+
+// whether glyph g is drawn from native pixels: all of them when the compiled font has them (pre),
+// otherwise through the cache when it is on, glyphs past a slot are drawn from the font
+static inline bool term_glyph_cached(bool cached, bool pre, uint32_t g) {
+    return pre || (cached && g < CUORETERM_GLYPH_CACHE_GLYPHS);
+}
+
+// glyph g as the run renderer wants it, native pixels from the compiled font or the cache, font bits
+// otherwise. colours here and below are already packed
+static inline const uint8_t *term_glyph_src(struct terminal *term, uint32_t g, uint32_t fg, uint32_t bg, bool cached, bool pre) {
+    if (pre) return term->font_pixels + g * term->font_height * term->font_width * term->pixel_bytes;
+    if (cached) return term_gcache_glyph(term, g, fg, bg);
+    return term->font_glyphs + g * term->glyph_bytes;
+}
+
+// n native pixels of colour col, black goes through the streaming fill
+static inline void term_fill_px(struct terminal *term, uint8_t *dst, uint32_t n, uint32_t col) {
+    if (!col) term_fb_fill(term, !term->shadow_addr, dst, 0x00, n * term->pixel_bytes);
+    else term->ops->fill(dst, n, col);
+}
+
+// draw n glyphs of one colour pair side by side from pixel px, py. walks one scanline at a time across
+// the whole run so every fb row is written in one contiguous sweep. the grid always draws opaque, it
+// repaints whole rows anyway and this saves clearing them first
+static void term_raster_run(struct terminal *term, uint32_t px, uint32_t py, const uint8_t **glyphs, uint32_t n,
+                            uint32_t fg, uint32_t bg, bool cached) {
+    TERM_STAT_START(t0);
+    uint8_t *line = (uint8_t*)term->draw_addr + py * term->fb_pitch + px * term->pixel_bytes;
+    uint32_t row_bytes = term->font_width * term->pixel_bytes;
+
+    if (cached) {
+        for (uint32_t r = 0; r < term->font_height; r++, line += term->fb_pitch) {
+            uint8_t *dst = line;
+            uint32_t off = r * row_bytes;
+            for (uint32_t i = 0; i < n; i++, dst += row_bytes)
+                h_copy_row(dst, glyphs[i] + off, row_bytes);
+        }
+    } else if (term->glyph_blit) {
+        // whole bytes of a glyph row go through the 8 pixel kernels, the bits left over and the cell
+        // columns past the glyph are done one pixel at a time
+        uint32_t full = term->glyph_w >> 3, tail = term->glyph_w & 7;
+        uint32_t pad = term->font_width - term->glyph_w;
+        uint32_t step = 8 * term->pixel_bytes;
+        bool opaque = term->opaque || term->cells || term->gcache_slots; // like the cached glyphs around them
+
+        for (uint32_t r = 0; r < term->font_height; r++, line += term->fb_pitch) {
+            uint8_t *dst = line;
+
+            if (r >= term->glyph_h) {
+                // below the glyphs, only the background of opaque cells
+                if (opaque) term_fill_px(term, dst, n * term->font_width, bg);
+                continue;
+            }
+
+            uint32_t off = r * term->glyph_stride;
+
+            // plain 8 pixel cells, one kernel call per glyph
+            if (full == 1 && !tail && !pad) {
+                if (opaque) for (uint32_t i = 0; i < n; i++, dst += row_bytes) term->opaque_blit(dst, term->fb_pitch, glyphs[i] + off, 1, fg, bg);
+                else for (uint32_t i = 0; i < n; i++, dst += row_bytes) term->glyph_blit(dst, term->fb_pitch, glyphs[i] + off, 1, fg);
+                continue;
+            }
+
+            for (uint32_t i = 0; i < n; i++, dst += row_bytes) {
+                const uint8_t *bits = glyphs[i] + off;
+                uint8_t *d = dst;
+
+                if (opaque) {
+                    for (uint32_t b = 0; b < full; b++, d += step) term->opaque_blit(d, term->fb_pitch, bits + b, 1, fg, bg);
+                    if (tail || pad) term->ops->expand(d, bits + full, tail, tail + pad, fg, bg);
+                } else {
+                    for (uint32_t b = 0; b < full; b++, d += step) term->glyph_blit(d, term->fb_pitch, bits + b, 1, fg);
+                    for (uint32_t x = 0; x < tail; x++)
+                        if (bits[full] & (0x80 >> x)) term->ops->pixel(d + x * term->pixel_bytes, fg);
+                }
+            }
+        }
+    }
+
+    term_damage(term, px, py, n * term->font_width, term->font_height);
+
+    TERM_STAT_ADD(term, glyphs, n);
+    TERM_STAT_DRAWN(term, (uint64_t)n * row_bytes * term->font_height);
+    TERM_STAT_CYCLES(term, cycles_glyph, t0);
+}
+
+// render n cells starting at column x of the text row at pixel py. glyphs draw opaque so every pixel is
+// written exactly once: empty cells of one bg are a fill, cells of one colour pair go out as a single run
+static void term_render_cells(struct terminal *term, uint32_t py, uint32_t x0, const struct cuoreterm_cell *row, uint32_t cells,
+                              bool cached) {
+    const uint8_t *glyphs[CUORETERM_RUN_MAX];
+
+    // cells keep 0xRRGGBB, a colour is only packed again when it differs from the previous run's
+    uint32_t fg_rgb = term->fgcol, f = term->fg_px, bg_rgb = term->bgcol, b = term->bg_px;
+
+    for (uint32_t x = 0; x < cells;) {
+        uint32_t fg = row[x].fg, bg = row[x].bg, n = 0;
+        if (bg != bg_rgb) { bg_rgb = bg; b = term_pack(&term->fmt, bg); }
+
+        if (!row[x].ch) {
+            while (x + n < cells && !row[x + n].ch && row[x + n].bg == bg) n++;
+
+            uint8_t *start = (uint8_t*)term->draw_addr + py * term->fb_pitch + (x0 + x) * term->font_width * term->pixel_bytes;
+            for (uint32_t r = 0; r < term->font_height; r++)
+                term_fill_px(term, start + r * term->fb_pitch, n * term->font_width, b);
+            TERM_STAT_DRAWN(term, (uint64_t)n * term->font_width * term->pixel_bytes * term->font_height);
+            x += n;
+            continue;
+        }
+
+        if (fg != fg_rgb) { fg_rgb = fg; f = term_pack(&term->fmt, fg); }
+
+        // glyphs past the cache break the run, it is drawn from one or the other
+        bool pre = term_font_pixels_ok(term, f, b);
+        bool run_cached = term_glyph_cached(cached, pre, term_glyph_index(term, row[x].ch));
+        while (x + n < cells && n < CUORETERM_RUN_MAX && row[x + n].ch && row[x + n].fg == fg && row[x + n].bg == bg) {
+            uint32_t g = term_glyph_index(term, row[x + n].ch);
+            if (term_glyph_cached(cached, pre, g) != run_cached) break;
+            glyphs[n++] = term_glyph_src(term, g, f, b, run_cached, pre);
+        }
+
+        term_raster_run(term, (x0 + x) * term->font_width, py, glyphs, n, f, b, run_cached);
+        x += n;
+    }
+}
+
+// render a scrollback line into the text row at pixel py, unpacked a run's worth of cells at a time
+static void term_render_history(struct terminal *term, uint32_t py, uint32_t back) {
+    const struct term_sb_line *line = term_sb_find(term, back);
+    const struct term_sb_run *run = (const struct term_sb_run*)(line + 1);
+    uint32_t runs = line->runs & ~TERM_SB_WIDE;
+    const uint8_t *chars = (const uint8_t*)(run + runs);
+    const uint32_t *wide = (line->runs & TERM_SB_WIDE) ? (const uint32_t*)chars : 0;
+    uint32_t n = line->chars < term->cols ? line->chars : term->cols;
+
+    struct cuoreterm_cell cells[CUORETERM_RUN_MAX];
+    uint32_t left = runs ? run->count : 0;
+
+    for (uint32_t x = 0; x < n;) {
+        uint32_t k = 0;
+        for (; k < CUORETERM_RUN_MAX && x + k < n; k++) {
+            while (!left) left = (++run)->count;
+            cells[k] = (struct cuoreterm_cell){ wide ? wide[x + k] : chars[x + k], run->fg, run->bg };
+            left--;
+        }
+        term_render_cells(term, py, x, cells, k, term->gcache_slots != 0);
+        x += k;
+    }
+
+    // the trimmed tail was blank
+    uint8_t *start = (uint8_t*)term->draw_addr + py * term->fb_pitch + n * term->font_width * term->pixel_bytes;
+    for (uint32_t r = 0; r < term->font_height && n < term->cols; r++)
+        term_fill_px(term, start + r * term->fb_pitch, (term->cols - n) * term->font_width, 0);
+}
+
+static inline bool term_cell_same(const struct cuoreterm_cell *a, const struct cuoreterm_cell *b) {
+    return a->ch == b->ch && a->fg == b->fg && a->bg == b->bg;
+}
+
+// 8 bytes at a time, rows that did not change at all are the common case
+static bool term_cells_equal(const struct cuoreterm_cell *a, const struct cuoreterm_cell *b, uint32_t n) {
+    const uint8_t *p = (const uint8_t*)a, *q = (const uint8_t*)b;
+    uint32_t bytes = n * sizeof(struct cuoreterm_cell);
+
+    for (; bytes >= 8; p += 8, q += 8, bytes -= 8)
+        if (*(const uint64_t*)p != *(const uint64_t*)q) return false;
+    for (; bytes; p++, q++, bytes--)
+        if (*p != *q) return false;
+    return true;
+}
+
+// put screen row y (grid row y - view) on screen if its grid row changed. with prev only the cells
+// that differ from what is already there get rendered and damaged
+static void term_present_row(struct terminal *term, uint32_t y, bool cached) {
+    uint32_t g = y - term->sb_view;
+    if (!term->view_redraw && !term_grid_row_dirty(term, g)) return;
+
+    const struct cuoreterm_cell *row = term_grid_row(term, g);
+    uint32_t py = y * term->font_height;
+
+    if (!term->prev) {
+        term_damage(term, 0, py, term->cols * term->font_width, term->font_height);
+        term_render_cells(term, py, 0, row, term->cols, cached);
+        return;
+    }
+
+    struct cuoreterm_cell *old = term->prev + y * term->cols;
+    if (term_cells_equal(row, old, term->cols)) return;
+
+    for (uint32_t x = 0; x < term->cols;) {
+        if (term_cell_same(&row[x], &old[x])) { x++; continue; }
+
+        uint32_t n = 1;
+        while (x + n < term->cols && !term_cell_same(&row[x + n], &old[x + n])) n++;
+
+        term_damage(term, x * term->font_width, py, n * term->font_width, term->font_height);
+        term_render_cells(term, py, x, row + x, n, cached);
+        h_copy_row((uint8_t*)(old + x), (const uint8_t*)(row + x), n * sizeof(struct cuoreterm_cell));
+        x += n;
+    }
+}
+
+// screen rows y0 up to y1 of one band, all showing grid rows
+struct term_band {
+    struct terminal *term;
+    uint32_t y0, y1, per;
+};
+
+static void term_band_task(void *arg, uint32_t index) {
+    const struct term_band *b = (const struct term_band*)arg;
+    uint32_t y0 = b->y0 + index * b->per;
+    uint32_t y1 = y0 + b->per < b->y1 ? y0 + b->per : b->y1;
+
+    for (uint32_t y = y0; y < y1; y++) term_present_row(b->term, y, false);
+}
+
+// re-render the screen rows whose grid rows changed (or all of them when the view moved), then push
+// the shadow to the framebuffer. scrolled back by v lines, screen row y shows history for y < v and
+// grid row y - v below that
+static void term_present(struct terminal *term) {
+    TERM_STAT_START(t0);
+
+    if (term->cells && (term->grid_dirty0 < term->grid_dirty1 || term->view_redraw)) {
+        uint32_t band = term->cols * term->font_width;
+        uint32_t v = term->sb_view;
+        uint32_t y0 = term->grid_dirty0 + v, y1 = term->grid_dirty1 + v;
+
+        if (term->view_redraw) { y0 = 0; y1 = term->rows; }
+        else if (term->grid_dirty0 >= term->grid_dirty1) y0 = y1 = 0;
+        if (y1 > term->rows) y1 = term->rows;
+
+        // history rows first, their lookups share a cursor into the scrollback
+        for (; y0 < y1 && y0 < v; y0++) {
+            uint32_t py = y0 * term->font_height;
+            term_damage(term, 0, py, band, term->font_height);
+            term_render_history(term, py, v - y0);
+            term_prev_forget(term, y0, y0 + 1);
+        }
+
+        uint32_t per = term->tasks > 1 ? (y1 - y0 + term->tasks - 1) / term->tasks : 0;
+
+        if (term->run_tasks && per && y1 - y0 > per) {
+            // damage the whole rect up front so the bands only ever read it
+            struct term_band b = { term, y0, y1, per };
+            term_damage(term, 0, y0 * term->font_height, band, (y1 - y0) * term->font_height);
+            term->run_tasks(term->tasks_ctx, term_band_task, &b, (y1 - y0 + per - 1) / per);
+        } else {
+            for (uint32_t y = y0; y < y1; y++) term_present_row(term, y, term->gcache_slots != 0);
+        }
+
+        h_memset(term->grid_dirty_bits, 0x00, sizeof(term->grid_dirty_bits));
+        term->grid_dirty0 = UINT32_MAX;
+        term->grid_dirty1 = 0;
+        term->view_redraw = false;
+    }
+
+    term_flush(term);
+    term_store_fence();
+    TERM_STAT_CYCLES(term, cycles_present, t0);
+}
+
+static inline uint32_t term_run_char(const uint8_t *s, const uint32_t *wide, uint32_t i) {
+    return s ? s[i] : wide[i];
+}
+
+// put n printable characters that all fit on the cursor's line in the current colours, then advance the
+// cursor past them. they are the bytes of s (ascii, or latin-1 from draw_char) or, when s is NULL, the
+// codepoints of wide. lines that this write scrolls off again before it returns are never drawn
+static void term_put_run(struct terminal *term, const uint8_t *s, const uint32_t *wide, uint32_t n) {
+    uint32_t y;
+
+    if (!term_cursor_row(term, &y)) {
+        // off screen by the end of this write, or just measuring
+    } else if (term->cells) {
+        struct cuoreterm_cell *cell = term_grid_row(term, y) + term->cursor_x;
+        for (uint32_t i = 0; i < n; i++) cell[i] = (struct cuoreterm_cell){ term_run_char(s, wide, i), term->fgcol, term->bgcol };
+        term_grid_dirty(term, y, y + 1);
+    } else {
+        const uint8_t *glyphs[CUORETERM_RUN_MAX];
+        uint32_t px = term->cursor_x * term->font_width;
+        uint32_t py = y * term->font_height;
+        bool cached = term->gcache_slots != 0;
+        bool pre = term_font_pixels_ok(term, term->fg_px, term->bg_px);
+
+        for (uint32_t done = 0; done < n;) {
+            uint32_t chunk = 0;
+            bool run_cached = term_glyph_cached(cached, pre, term_glyph_index(term, term_run_char(s, wide, done)));
+            while (done + chunk < n && chunk < CUORETERM_RUN_MAX) {
+                uint32_t g = term_glyph_index(term, term_run_char(s, wide, done + chunk));
+                if (term_glyph_cached(cached, pre, g) != run_cached) break;
+                glyphs[chunk++] = term_glyph_src(term, g, term->fg_px, term->bg_px, run_cached, pre);
+            }
+
+            term_raster_run(term, px + done * term->font_width, py, glyphs, chunk, term->fg_px, term->bg_px, run_cached);
+            done += chunk;
+        }
+    }
+
+    term->cursor_x += n;
+    if (term->cursor_x >= term->cols) term_newline(term);
+}
+
+static void term_draw_char(struct terminal *term, char c, uint32_t fg) {
+    if (!term->font_width) return;
+    if (c == '\n') { term_newline(term); return; }
+
+    // in fg without disturbing the colour set by escapes
+    uint32_t rgb = term->fgcol, px = term->fg_px;
+    term->fgcol = fg;
+    term->fg_px = term_pack(&term->fmt, fg);
+
+    uint8_t ch = (uint8_t)c;
+    term_put_run(term, &ch, 0, 1);
+
+    term->fgcol = rgb;
+    term->fg_px = px;
+}
+
+void cuoreterm_draw_char(struct terminal *term, char c, uint32_t fg) {
+    term_draw_char(term, c, fg);
+    if (!term->deferred) term_present(term);
+}
+
+static uint8_t hex_lut[256] = {
+    ['0']=0, ['1']=1, ['2']=2, ['3']=3, ['4']=4,
+    ['5']=5, ['6']=6, ['7']=7, ['8']=8, ['9']=9,
+    ['a']=10,['b']=11,['c']=12,['d']=13,['e']=14,['f']=15,
+    ['A']=10,['B']=11,['C']=12,['D']=13,['E']=14,['F']=15,
+};
+
+// blank cells x0 up to x1 of cursor row y in the current bg, rows this write scrolls away are skipped
+static void term_erase(struct terminal *term, uint32_t y, uint32_t x0, uint32_t x1) {
+    if (term->measuring || y < term->scroll_ahead || x0 >= x1) return;
+    y -= term->scroll_ahead;
+
+    if (term->cells) {
+        struct cuoreterm_cell *cell = term_grid_row(term, y);
+        for (uint32_t x = x0; x < x1; x++) cell[x] = (struct cuoreterm_cell){ 0, 0, term->bgcol };
+        term_grid_dirty(term, y, y + 1);
+        return;
+    }
+
+    uint32_t px = x0 * term->font_width;
+    uint32_t py = y * term->font_height;
+    uint32_t w = (x1 - x0) * term->font_width;
+
+    uint8_t *start = (uint8_t *)term->draw_addr + py * term->fb_pitch + px * term->pixel_bytes;
+    for (uint32_t r = 0; r < term->font_height; r++)
+        term_fill_px(term, start + r * term->fb_pitch, w, term->bg_px);
+    term_damage(term, px, py, w, term->font_height);
+    TERM_STAT_DRAWN(term, (uint64_t)w * term->pixel_bytes * term->font_height);
+}
+
+static inline void term_set_fg(struct terminal *term, uint32_t rgb, uint32_t px) { term->fgcol = rgb; term->fg_px = px; }
+static inline void term_set_bg(struct terminal *term, uint32_t rgb, uint32_t px) { term->bgcol = rgb; term->bg_px = px; }
+
+// the colour after a 38 or 48 at params[*i]: 5;n from the palette or 2;r;g;b, moves *i past it.
+// false when the params are cut short or malformed
+static bool term_sgr_colour(struct terminal *term, uint32_t *i, uint32_t *rgb, uint32_t *px) {
+    struct cuoreterm_vt *vt = &term->vt;
+    uint32_t k = *i + 1;
+
+    if (k < vt->nparams && vt->params[k] == 5 && k + 1 < vt->nparams) {
+        uint32_t n = vt->params[k + 1] & 0xFF;
+        *rgb = term_palette_rgb(n);
+        *px = term->palette[n];
+        *i = k + 1;
+        return true;
+    }
+    if (k < vt->nparams && vt->params[k] == 2 && k + 3 < vt->nparams) {
+        uint32_t r = vt->params[k + 1], g = vt->params[k + 2], b = vt->params[k + 3];
+        *rgb = ((r > 255 ? 255 : r) << 16) | ((g > 255 ? 255 : g) << 8) | (b > 255 ? 255 : b);
+        *px = term_pack(&term->fmt, *rgb);
+        *i = k + 3;
+        return true;
+    }
+
+    *i = vt->nparams; // can't tell where it ends, drop the rest
+    return false;
+}
+
+static void term_sgr(struct terminal *term) {
+    struct cuoreterm_vt *vt = &term->vt;
+    if (!vt->nparams) vt->params[vt->nparams++] = 0; // ESC[m is ESC[0m
+
+    for (uint32_t i = 0; i < vt->nparams; i++) {
+        uint32_t p = vt->params[i], rgb, px;
+
+        if (p == 0) { term_set_fg(term, 0xFFFFFF, term->palette[15]); term_set_bg(term, 0x000000, term->palette[0]); }
+        else if (p == 39) term_set_fg(term, 0xFFFFFF, term->palette[15]);
+        else if (p == 49) term_set_bg(term, 0x000000, term->palette[0]);
+        else if (p >= 30 && p <= 37) term_set_fg(term, term_ansi_rgb[p - 30], term->palette[p - 30]);
+        else if (p >= 40 && p <= 47) term_set_bg(term, term_ansi_rgb[p - 40], term->palette[p - 40]);
+        else if (p >= 90 && p <= 97) term_set_fg(term, term_ansi_rgb[p - 90 + 8], term->palette[p - 90 + 8]);
+        else if (p >= 100 && p <= 107) term_set_bg(term, term_ansi_rgb[p - 100 + 8], term->palette[p - 100 + 8]);
+        else if (p == 38 && term_sgr_colour(term, &i, &rgb, &px)) term_set_fg(term, rgb, px);
+        else if (p == 48 && term_sgr_colour(term, &i, &rgb, &px)) term_set_bg(term, rgb, px);
+    }
+}
+
+static void term_csi_dispatch(struct terminal *term, uint8_t final) {
+    struct cuoreterm_vt *vt = &term->vt;
+    uint32_t p0 = vt->nparams > 0 ? vt->params[0] : 0;
+    uint32_t p1 = vt->nparams > 1 ? vt->params[1] : 0;
+    uint32_t n = p0 ? p0 : 1;
+    uint32_t last_x = term->cols ? term->cols - 1 : 0, last_y = term->rows ? term->rows - 1 : 0;
+
+    switch(final) {
+        case 'm': term_sgr(term); break;
+        case 'A': term->cursor_y -= n < term->cursor_y ? n : term->cursor_y; break;
+        case 'B': term->cursor_y = term->cursor_y + n < last_y ? term->cursor_y + n : last_y; break;
+        case 'C': term->cursor_x = term->cursor_x + n < last_x ? term->cursor_x + n : last_x; break;
+        case 'D': term->cursor_x -= n < term->cursor_x ? n : term->cursor_x; break;
+        case 'G': term->cursor_x = n - 1 < last_x ? n - 1 : last_x; break;
+        case 'd': term->cursor_y = n - 1 < last_y ? n - 1 : last_y; break;
+        case 'H':
+        case 'f':
+            term->cursor_y = (p0 ? p0 - 1 : 0) < last_y ? (p0 ? p0 - 1 : 0) : last_y;
+            term->cursor_x = (p1 ? p1 - 1 : 0) < last_x ? (p1 ? p1 - 1 : 0) : last_x;
+            break;
+        case 'J':
+            if (p0 == 0) {
+                term_erase(term, term->cursor_y, term->cursor_x, term->cols);
+                for (uint32_t y = term->cursor_y + 1; y < term->rows; y++) term_erase(term, y, 0, term->cols);
+            } else if (p0 == 1) {
+                for (uint32_t y = 0; y < term->cursor_y; y++) term_erase(term, y, 0, term->cols);
+                term_erase(term, term->cursor_y, 0, term->cursor_x + 1);
+            } else {
+                for (uint32_t y = 0; y < term->rows; y++) term_erase(term, y, 0, term->cols);
+                if (p0 == 3 && term->sb && !term->measuring) term_sb_reset(term);
+            }
+            break;
+        case 'K':
+            if (p0 == 0) term_erase(term, term->cursor_y, term->cursor_x, term->cols);
+            else if (p0 == 1) term_erase(term, term->cursor_y, 0, term->cursor_x + 1);
+            else term_erase(term, term->cursor_y, 0, term->cols);
+            break;
+        case 'r': {
+            // DECSTBM, at least two rows or it is ignored. the cursor goes home
+            uint32_t top = p0 ? p0 - 1 : 0, bottom = p1 && p1 < term->rows ? p1 : term->rows;
+            if (top + 1 >= bottom) break;
+            term->scroll_top = top;
+            term->scroll_bottom = bottom;
+            term->cursor_x = 0;
+            term->cursor_y = 0;
+            break;
+        }
+    }
+}
+
+// bytes after ESC that are not '['
+static void term_esc_dispatch(struct terminal *term, uint8_t c) {
+    struct cuoreterm_vt *vt = &term->vt;
+
+    switch(c) {
+        case '7': vt->saved_x = term->cursor_x; vt->saved_y = term->cursor_y; break;
+        case '8':
+            term->cursor_x = vt->saved_x < term->cols ? vt->saved_x : 0;
+            term->cursor_y = vt->saved_y < term->rows ? vt->saved_y : 0;
+            break;
+    }
+}
+
+// the parser is a table: byte class x state gives the next state and what to do with the byte
+enum { TERM_VT_GROUND, TERM_VT_ESC, TERM_VT_CSI, TERM_VT_HEX, TERM_VT_IGNORE, TERM_VT_STATES };
+enum { TERM_VC_DIGIT, TERM_VC_HEXALPHA, TERM_VC_SEMI, TERM_VC_HASH, TERM_VC_PRIV, TERM_VC_INTER, TERM_VC_FINAL,
+       TERM_VC_LBRACKET, TERM_VC_CTRL, TERM_VC_CAN, TERM_VC_ESC, TERM_VC_DEL, TERM_VC_OTHER, TERM_VC_CLASSES };
+enum { TERM_VA_NONE, TERM_VA_CSI, TERM_VA_PARAM, TERM_VA_NEXT, TERM_VA_HEX, TERM_VA_HEXDIGIT,
+       TERM_VA_DISPATCH, TERM_VA_HEXDISPATCH, TERM_VA_ESCDISPATCH, TERM_VA_EXECUTE };
+
+#define TERM_VT(next, act) (uint8_t)(((act) << 4) | (next))
+
+// class of each ascii byte, anything from 0x80 up is TERM_VC_OTHER
+static const uint8_t term_vt_class[128] = {
+    TERM_VC_CTRL,     TERM_VC_CTRL,     TERM_VC_CTRL,     TERM_VC_CTRL,     TERM_VC_CTRL,     TERM_VC_CTRL,     TERM_VC_CTRL,     TERM_VC_CTRL,
+    TERM_VC_CTRL,     TERM_VC_CTRL,     TERM_VC_CTRL,     TERM_VC_CTRL,     TERM_VC_CTRL,     TERM_VC_CTRL,     TERM_VC_CTRL,     TERM_VC_CTRL,
+    TERM_VC_CTRL,     TERM_VC_CTRL,     TERM_VC_CTRL,     TERM_VC_CTRL,     TERM_VC_CTRL,     TERM_VC_CTRL,     TERM_VC_CTRL,     TERM_VC_CTRL,
+    TERM_VC_CAN,      TERM_VC_CTRL,     TERM_VC_CAN,      TERM_VC_ESC,      TERM_VC_CTRL,     TERM_VC_CTRL,     TERM_VC_CTRL,     TERM_VC_CTRL,
+    TERM_VC_INTER,    TERM_VC_INTER,    TERM_VC_INTER,    TERM_VC_HASH,     TERM_VC_INTER,    TERM_VC_INTER,    TERM_VC_INTER,    TERM_VC_INTER,
+    TERM_VC_INTER,    TERM_VC_INTER,    TERM_VC_INTER,    TERM_VC_INTER,    TERM_VC_INTER,    TERM_VC_INTER,    TERM_VC_INTER,    TERM_VC_INTER,
+    TERM_VC_DIGIT,    TERM_VC_DIGIT,    TERM_VC_DIGIT,    TERM_VC_DIGIT,    TERM_VC_DIGIT,    TERM_VC_DIGIT,    TERM_VC_DIGIT,    TERM_VC_DIGIT,
+    TERM_VC_DIGIT,    TERM_VC_DIGIT,    TERM_VC_SEMI,     TERM_VC_SEMI,     TERM_VC_PRIV,     TERM_VC_PRIV,     TERM_VC_PRIV,     TERM_VC_PRIV,
+    TERM_VC_FINAL,    TERM_VC_HEXALPHA, TERM_VC_HEXALPHA, TERM_VC_HEXALPHA, TERM_VC_HEXALPHA, TERM_VC_HEXALPHA, TERM_VC_HEXALPHA, TERM_VC_FINAL,
+    TERM_VC_FINAL,    TERM_VC_FINAL,    TERM_VC_FINAL,    TERM_VC_FINAL,    TERM_VC_FINAL,    TERM_VC_FINAL,    TERM_VC_FINAL,    TERM_VC_FINAL,
+    TERM_VC_FINAL,    TERM_VC_FINAL,    TERM_VC_FINAL,    TERM_VC_FINAL,    TERM_VC_FINAL,    TERM_VC_FINAL,    TERM_VC_FINAL,    TERM_VC_FINAL,
+    TERM_VC_FINAL,    TERM_VC_FINAL,    TERM_VC_FINAL,    TERM_VC_LBRACKET, TERM_VC_FINAL,    TERM_VC_FINAL,    TERM_VC_FINAL,    TERM_VC_FINAL,
+    TERM_VC_FINAL,    TERM_VC_HEXALPHA, TERM_VC_HEXALPHA, TERM_VC_HEXALPHA, TERM_VC_HEXALPHA, TERM_VC_HEXALPHA, TERM_VC_HEXALPHA, TERM_VC_FINAL,
+    TERM_VC_FINAL,    TERM_VC_FINAL,    TERM_VC_FINAL,    TERM_VC_FINAL,    TERM_VC_FINAL,    TERM_VC_FINAL,    TERM_VC_FINAL,    TERM_VC_FINAL,
+    TERM_VC_FINAL,    TERM_VC_FINAL,    TERM_VC_FINAL,    TERM_VC_FINAL,    TERM_VC_FINAL,    TERM_VC_FINAL,    TERM_VC_FINAL,    TERM_VC_FINAL,
+    TERM_VC_FINAL,    TERM_VC_FINAL,    TERM_VC_FINAL,    TERM_VC_FINAL,    TERM_VC_FINAL,    TERM_VC_FINAL,    TERM_VC_FINAL,    TERM_VC_DEL,
+};
+
+static const uint8_t term_vt_table[TERM_VT_STATES][TERM_VC_CLASSES] = {
+    [TERM_VT_ESC] = {
+        [TERM_VC_DIGIT]    = TERM_VT(TERM_VT_GROUND, TERM_VA_ESCDISPATCH),
+        [TERM_VC_HEXALPHA] = TERM_VT(TERM_VT_GROUND, TERM_VA_ESCDISPATCH),
+        [TERM_VC_SEMI]     = TERM_VT(TERM_VT_GROUND, TERM_VA_NONE),
+        [TERM_VC_HASH]     = TERM_VT(TERM_VT_IGNORE, TERM_VA_NONE),
+        [TERM_VC_PRIV]     = TERM_VT(TERM_VT_GROUND, TERM_VA_NONE),
+        [TERM_VC_INTER]    = TERM_VT(TERM_VT_IGNORE, TERM_VA_NONE),
+        [TERM_VC_FINAL]    = TERM_VT(TERM_VT_GROUND, TERM_VA_ESCDISPATCH),
+        [TERM_VC_LBRACKET] = TERM_VT(TERM_VT_CSI, TERM_VA_CSI),
+        [TERM_VC_CTRL]     = TERM_VT(TERM_VT_ESC, TERM_VA_EXECUTE),
+        [TERM_VC_CAN]      = TERM_VT(TERM_VT_GROUND, TERM_VA_NONE),
+        [TERM_VC_ESC]      = TERM_VT(TERM_VT_ESC, TERM_VA_NONE),
+        [TERM_VC_DEL]      = TERM_VT(TERM_VT_ESC, TERM_VA_NONE),
+        [TERM_VC_OTHER]    = TERM_VT(TERM_VT_GROUND, TERM_VA_NONE),
+    },
+    [TERM_VT_CSI] = {
+        [TERM_VC_DIGIT]    = TERM_VT(TERM_VT_CSI, TERM_VA_PARAM),
+        [TERM_VC_HEXALPHA] = TERM_VT(TERM_VT_GROUND, TERM_VA_DISPATCH),
+        [TERM_VC_SEMI]     = TERM_VT(TERM_VT_CSI, TERM_VA_NEXT),
+        [TERM_VC_HASH]     = TERM_VT(TERM_VT_HEX, TERM_VA_HEX),
+        [TERM_VC_PRIV]     = TERM_VT(TERM_VT_IGNORE, TERM_VA_NONE),
+        [TERM_VC_INTER]    = TERM_VT(TERM_VT_IGNORE, TERM_VA_NONE),
+        [TERM_VC_FINAL]    = TERM_VT(TERM_VT_GROUND, TERM_VA_DISPATCH),
+        [TERM_VC_LBRACKET] = TERM_VT(TERM_VT_GROUND, TERM_VA_NONE),
+        [TERM_VC_CTRL]     = TERM_VT(TERM_VT_CSI, TERM_VA_EXECUTE),
+        [TERM_VC_CAN]      = TERM_VT(TERM_VT_GROUND, TERM_VA_NONE),
+        [TERM_VC_ESC]      = TERM_VT(TERM_VT_ESC, TERM_VA_NONE),
+        [TERM_VC_DEL]      = TERM_VT(TERM_VT_CSI, TERM_VA_NONE),
+        [TERM_VC_OTHER]    = TERM_VT(TERM_VT_GROUND, TERM_VA_NONE),
+    },
+    [TERM_VT_HEX] = {
+        [TERM_VC_DIGIT]    = TERM_VT(TERM_VT_HEX, TERM_VA_HEXDIGIT),
+        [TERM_VC_HEXALPHA] = TERM_VT(TERM_VT_HEX, TERM_VA_HEXDIGIT),
+        [TERM_VC_SEMI]     = TERM_VT(TERM_VT_IGNORE, TERM_VA_NONE),
+        [TERM_VC_HASH]     = TERM_VT(TERM_VT_IGNORE, TERM_VA_NONE),
+        [TERM_VC_PRIV]     = TERM_VT(TERM_VT_IGNORE, TERM_VA_NONE),
+        [TERM_VC_INTER]    = TERM_VT(TERM_VT_IGNORE, TERM_VA_NONE),
+        [TERM_VC_FINAL]    = TERM_VT(TERM_VT_GROUND, TERM_VA_HEXDISPATCH),
+        [TERM_VC_LBRACKET] = TERM_VT(TERM_VT_GROUND, TERM_VA_NONE),
+        [TERM_VC_CTRL]     = TERM_VT(TERM_VT_HEX, TERM_VA_EXECUTE),
+        [TERM_VC_CAN]      = TERM_VT(TERM_VT_GROUND, TERM_VA_NONE),
+        [TERM_VC_ESC]      = TERM_VT(TERM_VT_ESC, TERM_VA_NONE),
+        [TERM_VC_DEL]      = TERM_VT(TERM_VT_HEX, TERM_VA_NONE),
+        [TERM_VC_OTHER]    = TERM_VT(TERM_VT_GROUND, TERM_VA_NONE),
+    },
+    [TERM_VT_IGNORE] = {
+        [TERM_VC_DIGIT]    = TERM_VT(TERM_VT_IGNORE, TERM_VA_NONE),
+        [TERM_VC_HEXALPHA] = TERM_VT(TERM_VT_GROUND, TERM_VA_NONE),
+        [TERM_VC_SEMI]     = TERM_VT(TERM_VT_IGNORE, TERM_VA_NONE),
+        [TERM_VC_HASH]     = TERM_VT(TERM_VT_IGNORE, TERM_VA_NONE),
+        [TERM_VC_PRIV]     = TERM_VT(TERM_VT_IGNORE, TERM_VA_NONE),
+        [TERM_VC_INTER]    = TERM_VT(TERM_VT_IGNORE, TERM_VA_NONE),
+        [TERM_VC_FINAL]    = TERM_VT(TERM_VT_GROUND, TERM_VA_NONE),
+        [TERM_VC_LBRACKET] = TERM_VT(TERM_VT_GROUND, TERM_VA_NONE),
+        [TERM_VC_CTRL]     = TERM_VT(TERM_VT_IGNORE, TERM_VA_EXECUTE),
+        [TERM_VC_CAN]      = TERM_VT(TERM_VT_GROUND, TERM_VA_NONE),
+        [TERM_VC_ESC]      = TERM_VT(TERM_VT_ESC, TERM_VA_NONE),
+        [TERM_VC_DEL]      = TERM_VT(TERM_VT_IGNORE, TERM_VA_NONE),
+        [TERM_VC_OTHER]    = TERM_VT(TERM_VT_GROUND, TERM_VA_NONE),
+    },
+};
+
+// control bytes the terminal acts on, anything else below 0x20 is drawn like the font has it
+static bool term_ground_ctrl(struct terminal *term, uint8_t c) {
+    switch(c) {
+        case '\n':
+            term_newline(term);
+            return true;
+        case '\r':
+            term->cursor_x = 0;
+            return true;
+        case '\t': {
+            uint32_t x = (term->cursor_x | 7) + 1;
+            term->cursor_x = x < term->cols ? x : (term->cols ? term->cols - 1 : 0);
+            return true;
+        }
+        case '\b':
+            if (term->cursor_x == 0) {
+                if (term->cursor_y == 0) return true;
+                term->cursor_y--;
+                term->cursor_x = term->cols - 1;
+            } else {
+                term->cursor_x--;
+            }
+            term_erase(term, term->cursor_y, term->cursor_x, term->cursor_x + 1);
+            return true;
+        case '\x1b':
+            term->vt.state = TERM_VT_ESC;
+            return true;
+    }
+    return false;
+}
+
+// feed one byte of an escape sequence. c0 controls in the middle of one are carried out on the spot
+// and the sequence goes on (vt500), DEL is dropped, CAN and SUB cancel it and ESC starts a new one
+static void term_vt_feed(struct terminal *term, uint8_t c) {
+    struct cuoreterm_vt *vt = &term->vt;
+    uint8_t t = term_vt_table[vt->state][c < 0x80 ? term_vt_class[c] : TERM_VC_OTHER];
+
+    vt->state = t & 0x0F;
+
+    uint8_t act = t >> 4;
+    if (act >= TERM_VA_DISPATCH && act <= TERM_VA_ESCDISPATCH && !term->measuring) TERM_STAT_ADD(term, escapes, 1);
+
+    switch(act) {
+        case TERM_VA_CSI:
+            vt->nparams = 0;
+            vt->params[0] = 0;
+            break;
+        case TERM_VA_PARAM:
+            if (!vt->nparams) vt->nparams = 1;
+            if (vt->nparams <= CUORETERM_VT_PARAMS) {
+                uint32_t v = vt->params[vt->nparams - 1] * 10 + (c - '0');
+                vt->params[vt->nparams - 1] = v > 0xFFFF ? 0xFFFF : (uint16_t)v;
+            }
+            break;
+        case TERM_VA_NEXT:
+            if (!vt->nparams) vt->nparams = 1;
+            if (vt->nparams < CUORETERM_VT_PARAMS) vt->params[vt->nparams] = 0;
+            if (vt->nparams <= CUORETERM_VT_PARAMS) vt->nparams++;
+            break;
+        case TERM_VA_HEX:
+            vt->hex = 0;
+            vt->nhex = 0;
+            break;
+        case TERM_VA_HEXDIGIT:
+            if (vt->nhex < 6) { vt->hex = (vt->hex << 4) | hex_lut[c]; vt->nhex++; }
+            break;
+        case TERM_VA_DISPATCH:
+            if (vt->nparams > CUORETERM_VT_PARAMS) vt->nparams = CUORETERM_VT_PARAMS;
+            term_csi_dispatch(term, c);
+            break;
+        case TERM_VA_HEXDISPATCH:
+            if (c == 'm' && vt->nhex == 6) term_set_fg(term, vt->hex, term_pack(&term->fmt, vt->hex));
+            break;
+        case TERM_VA_ESCDISPATCH:
+            term_esc_dispatch(term, c);
+            break;
+        case TERM_VA_EXECUTE:
+            term_ground_ctrl(term, c); // the rest of the c0 set does nothing inside a sequence
+            break;
+    }
+}
+
+#ifdef CUORETERM_X86_SIMD
+// 16 bytes per step, a byte is a control byte when min(byte, 0x1f) is the byte itself and
+// not ascii when its top bit is set
+__attribute__((target("sse2")))
+static const uint8_t *term_scan_ctrl_sse2(const uint8_t *p, const uint8_t *end) {
+    const __m128i lim = _mm_set1_epi8(0x1F);
+
+    for (; end - p >= 16; p += 16) {
+        __m128i x = _mm_loadu_si128((const __m128i*)p);
+        int m = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_min_epu8(x, lim), x)) | _mm_movemask_epi8(x);
+        if (m) return p + __builtin_ctz((uint32_t)m);
+    }
+    return p;
+}
+#endif
+
+// first byte in p up to end that is below 0x20 or starts a utf-8 sequence, or end
+static inline const uint8_t *term_scan_ctrl(const uint8_t *p, const uint8_t *end) {
+#ifdef CUORETERM_X86_SIMD
+    p = term_scan_ctrl_sse2(p, end);
+#endif
+    while (p < end && *p >= 0x20 && *p < 0x80) p++;
+    return p;
+}
+
+// decode utf-8 from p into at most room characters, stopping at a control byte or end, and put them on
+// screen as one run. sequences may continue into the next write, malformed ones are U+FFFD
+static const uint8_t *term_put_utf8(struct terminal *term, const uint8_t *p, const uint8_t *end, uint32_t room) {
+    struct cuoreterm_vt *vt = &term->vt;
+    uint32_t wide[CUORETERM_RUN_MAX];
+    uint32_t n = 0, max = room < CUORETERM_RUN_MAX ? room : CUORETERM_RUN_MAX;
+
+    for (; p < end && n < max; p++) {
+        uint8_t c = *p;
+
+        if (vt->utf8_need) {
+            if ((c & 0xC0) == 0x80) {
+                vt->utf8 = (vt->utf8 << 6) | (c & 0x3F);
+                if (--vt->utf8_need) continue;
+
+                uint32_t cp = vt->utf8;
+                bool bad = cp < vt->utf8_min || cp > 0x10FFFF || (cp >= 0xD800 && cp <= 0xDFFF);
+                wide[n++] = bad ? 0xFFFD : cp;
+                continue;
+            }
+
+            // cut short, c is looked at again on its own
+            vt->utf8_need = 0;
+            wide[n++] = 0xFFFD;
+            if (n == max) break;
+        }
+
+        if (c < 0x20) break;
+
+        if (c < 0x80) {
+            wide[n++] = c;
+        } else if (c >= 0xC2 && c <= 0xDF) {
+            vt->utf8 = c & 0x1F; vt->utf8_min = 0x80; vt->utf8_need = 1;
+        } else if ((c & 0xF0) == 0xE0) {
+            vt->utf8 = c & 0x0F; vt->utf8_min = 0x800; vt->utf8_need = 2;
+        } else if (c >= 0xF0 && c <= 0xF4) {
+            vt->utf8 = c & 0x07; vt->utf8_min = 0x10000; vt->utf8_need = 3;
+        } else {
+            wide[n++] = 0xFFFD;
+        }
+    }
+
+    if (n) term_put_run(term, 0, wide, n);
+    return p;
+}
+
+static void term_write_bytes(struct terminal *term, const char *msg, uint64_t len) {
+    const uint8_t *p = (const uint8_t *)msg;
+    const uint8_t *end = p + len;
+
+    while (p < end) {
+        if (term->vt.state != TERM_VT_GROUND) {
+            term_vt_feed(term, *p++);
+            continue;
+        }
+
+        uint32_t room = term->cols > term->cursor_x ? term->cols - term->cursor_x : 1;
+
+        if (!term->vt.utf8_need && *p < 0x80) {
+            if (*p < 0x20 && term_ground_ctrl(term, *p)) { p++; continue; }
+
+            // everything up to the next control byte, non ascii byte or the end of the line goes out as one run
+            const uint8_t *stop = (uint64_t)(end - p) > room ? p + room : end;
+            stop = term_scan_ctrl(p + 1, stop);
+
+            term_put_run(term, p, 0, (uint32_t)(stop - p));
+            p = stop;
+            continue;
+        }
+
+        p = term_put_utf8(term, p, end, room);
+    }
+}
+
+// newlines a write needs before it is measured first
+#define TERM_MEASURE_LINES 2
+
+// true once n newlines are found in msg
+static bool term_has_lines(const char *msg, uint64_t len, uint32_t n) {
+    for (uint64_t i = 0; i < len; i++)
+        if (msg[i] == '\n' && !--n) return true;
+    return false;
+}
+
+// a whole write up to, but not including, putting it on screen
+static void term_write(struct terminal *term, const char *msg, uint64_t len) {
+    if (!term->font_width) return; // no font yet, no cells to put it in
+
+    TERM_STAT_START(t0);
+
+    // only worth it for pixels, the grid draws nothing until present anyway, and only when the write
+    // holds a few lines: a one line printf at the bottom would just be parsed twice. every byte advances
+    // the cursor by at most one line, so short writes high up can't scroll
+    if (!term->cells && term->cursor_y + len >= term->rows && term_region_full(term) &&
+        term_has_lines(msg, len, TERM_MEASURE_LINES)) {
+        // walk the cursor over the whole write first to learn how far it scrolls in total, then
+        // scroll once by that much. lines that would only scroll off again are never drawn
+        uint32_t cx = term->cursor_x, cy = term->cursor_y;
+        uint32_t fg = term->fgcol, bg = term->bgcol, fg_px = term->fg_px, bg_px = term->bg_px;
+        struct cuoreterm_vt vt = term->vt;
+
+        term->measuring = true;
+        term->measure_abort = false;
+        term->scroll_ahead = 0;
+        term_write_bytes(term, msg, len);
+        term->measuring = false;
+
+        term->cursor_x = cx;
+        term->cursor_y = cy;
+        term_set_fg(term, fg, fg_px);
+        term_set_bg(term, bg, bg_px);
+        term->vt = vt;
+        term_region_reset(term); // it was the whole screen, the dry run may have set one
+
+        if (term->measure_abort) term->scroll_ahead = 0;
+        if (term->scroll_ahead) term_scroll_rows(term, 0, term->rows, term->scroll_ahead);
+    }
+
+    term_write_bytes(term, msg, len);
+    term->scroll_ahead = 0;
+    TERM_STAT_CYCLES(term, cycles_write, t0);
+}
+
+void cuoreterm_write(void *ctx, const char *msg, uint64_t len) {
+    struct terminal *term = (struct terminal *)ctx;
+
+    term_write(term, msg, len);
+    if (!term->deferred) term_present(term);
+}
+
+void cuoreterm_write_sync(void *ctx, const char *msg, uint64_t len) {
+    struct terminal *term = (struct terminal *)ctx;
+
+    term_write(term, msg, len);
+    term_present(term);
+}
+
+void cuoreterm_present(struct terminal *term) {
+    term_present(term);
+}
+
+void cuoreterm_set_task_hook(struct terminal *term, cuoreterm_run_tasks_fn run, void *ctx, uint32_t tasks) {
+    term->run_tasks = run;
+    term->tasks_ctx = ctx;
+    term->tasks = tasks;
+}
+
+void cuoreterm_set_deferred(struct terminal *term, bool on) {
+    term->deferred = on;
+    if (!on) term_present(term);
+}
+
+// formatted output. every piece goes through term_write on its own and the screen is presented once
+// at the end, so nothing is copied except a number's digits
+#define TERM_F_LEFT  (1u << 0)
+#define TERM_F_ZERO  (1u << 1)
+#define TERM_F_PLUS  (1u << 2)
+#define TERM_F_SPACE (1u << 3)
+#define TERM_F_ALT   (1u << 4)
+#define TERM_F_UPPER (1u << 5)
+
+#define TERM_NUM_MAX 32 // 22 octal digits of a u64, a sign or 0x and a few inline zeros
+
+static const char term_digits[] = "0123456789abcdef0123456789ABCDEF";
+static const char term_dec2[] = "00010203040506070809101112131415161718192021222324252627282930313233343536373839404142434445464748495051525354555657585960616263646566676869707172737475767778798081828384858687888990919293949596979899";
+
+// digits of v ending at end, returns where they start
+static char *term_utoa(char *end, uint64_t v, uint32_t base, bool upper) {
+    char *p = end;
+
+    if (base == 10) {
+        // two digits per division
+        while (v >= 100) {
+            uint32_t r = (uint32_t)(v % 100) * 2;
+            v /= 100;
+            p -= 2;
+            p[0] = term_dec2[r];
+            p[1] = term_dec2[r + 1];
+        }
+        if (v >= 10) {
+            p -= 2;
+            p[0] = term_dec2[v * 2];
+            p[1] = term_dec2[v * 2 + 1];
+        } else {
+            *--p = (char)('0' + v);
+        }
+        return p;
+    }
+
+    const char *dig = term_digits + (upper ? 16 : 0);
+    uint32_t shift = base == 16 ? 4 : 3;
+    do {
+        *--p = dig[v & (base - 1)];
+        v >>= shift;
+    } while (v);
+    return p;
+}
+
+static void term_pad(struct terminal *term, char c, uint32_t n) {
+    static const char zeros[] = "0000000000000000";
+    static const char spaces[] = "                ";
+    const char *s = c == '0' ? zeros : spaces;
+
+    while (n) {
+        uint32_t k = n < 16 ? n : 16;
+        term_write(term, s, k);
+        n -= k;
+    }
+}
+
+// prec < 0 is no precision
+static void term_put_num(struct terminal *term, uint64_t v, bool neg, uint32_t base, uint32_t flags,
+                         uint32_t width, int32_t prec) {
+    char buf[TERM_NUM_MAX];
+    char *end = buf + sizeof(buf);
+    char *s = (v == 0 && prec == 0) ? end : term_utoa(end, v, base, flags & TERM_F_UPPER);
+    uint32_t nd = (uint32_t)(end - s);
+
+    char pre[3];
+    uint32_t np = 0;
+    if (neg) pre[np++] = '-';
+    else if (flags & TERM_F_PLUS) pre[np++] = '+';
+    else if (flags & TERM_F_SPACE) pre[np++] = ' ';
+    if ((flags & TERM_F_ALT) && base == 16 && v) {
+        pre[np++] = '0';
+        pre[np++] = (flags & TERM_F_UPPER) ? 'X' : 'x';
+    }
+    if ((flags & TERM_F_ALT) && base == 8 && prec <= (int32_t)nd) prec = (int32_t)nd + (s == end || *s != '0');
+
+    uint32_t zeros = prec > (int32_t)nd ? (uint32_t)prec - nd : 0;
+    uint32_t body = np + zeros + nd;
+    uint32_t pad = width > body ? width - body : 0;
+    if ((flags & TERM_F_ZERO) && !(flags & TERM_F_LEFT) && prec < 0) {
+        zeros += pad;
+        pad = 0;
+    }
+
+    if (!(flags & TERM_F_LEFT)) term_pad(term, ' ', pad);
+
+    // sign, prefix and zeros go in front of the digits when they fit so it is all one piece
+    while (zeros && s > buf + sizeof(pre)) {
+        *--s = '0';
+        zeros--;
+    }
+    if (zeros) {
+        if (np) term_write(term, pre, np);
+        term_pad(term, '0', zeros);
+    } else {
+        s -= np;
+        for (uint32_t i = 0; i < np; i++) s[i] = pre[i];
+    }
+    if (s < end) term_write(term, s, (uint64_t)(end - s));
+
+    if (flags & TERM_F_LEFT) term_pad(term, ' ', pad);
+}
+
+static void term_put_str(struct terminal *term, const char *s, uint32_t flags, uint32_t width, int32_t prec) {
+    if (!s) s = "(null)";
+
+    uint64_t n = 0;
+    if (prec < 0) while (s[n]) n++;
+    else while (n < (uint64_t)prec && s[n]) n++;
+
+    uint32_t pad = width > n ? width - (uint32_t)n : 0;
+    if (!(flags & TERM_F_LEFT)) term_pad(term, ' ', pad);
+    if (n) term_write(term, s, n);
+    if (flags & TERM_F_LEFT) term_pad(term, ' ', pad);
+}
+
+static void term_vprintf(struct terminal *term, const char *fmt, va_list ap) {
+    const char *p = fmt;
+
+    for (;;) {
+        const char *lit = p;
+        while (*p && *p != '%') p++;
+        if (p > lit) term_write(term, lit, (uint64_t)(p - lit));
+        if (!*p) return;
+
+        const char *spec = p++;
+        uint32_t flags = 0;
+        for (;; p++) {
+            if (*p == '-') flags |= TERM_F_LEFT;
+            else if (*p == '0') flags |= TERM_F_ZERO;
+            else if (*p == '+') flags |= TERM_F_PLUS;
+            else if (*p == ' ') flags |= TERM_F_SPACE;
+            else if (*p == '#') flags |= TERM_F_ALT;
+            else break;
+        }
+
+        uint32_t width = 0;
+        if (*p == '*') {
+            int w = va_arg(ap, int);
+            if (w < 0) {
+                flags |= TERM_F_LEFT;
+                w = -w;
+            }
+            width = (uint32_t)w;
+            p++;
+        } else {
+            while (*p >= '0' && *p <= '9') width = width * 10 + (uint32_t)(*p++ - '0');
+        }
+
+        int32_t prec = -1;
+        if (*p == '.') {
+            p++;
+            prec = 0;
+            if (*p == '*') {
+                int v = va_arg(ap, int);
+                prec = v < 0 ? -1 : v;
+                p++;
+            } else {
+                while (*p >= '0' && *p <= '9') prec = prec * 10 + (*p++ - '0');
+            }
+        }
+
+        // 0 int, 1 h, 2 hh, 3 64 bit
+        uint32_t size = 0;
+        if (*p == 'h') size = *++p == 'h' ? (p++, 2) : 1;
+        else if (*p == 'l') size = *++p == 'l' ? (p++, 3) : (sizeof(long) == 8 ? 3 : 0);
+        else if (*p == 'z' || *p == 'j' || *p == 't') size = (p++, 3);
+
+        char c = *p;
+        if (!c) {
+            // cut off spec at the end, print it as it was
+            term_write(term, spec, (uint64_t)(p - spec));
+            return;
+        }
+        p++;
+
+        uint64_t v;
+        switch (c) {
+        case 'd': case 'i': {
+            int64_t sv = size == 3 ? va_arg(ap, long long) : va_arg(ap, int);
+            if (size == 1) sv = (short)sv;
+            else if (size == 2) sv = (signed char)sv;
+            v = sv < 0 ? 0 - (uint64_t)sv : (uint64_t)sv;
+            term_put_num(term, v, sv < 0, 10, flags, width, prec);
+            break;
+        }
+        case 'u': case 'x': case 'X': case 'o':
+            v = size == 3 ? va_arg(ap, unsigned long long) : va_arg(ap, unsigned int);
+            if (size == 1) v = (unsigned short)v;
+            else if (size == 2) v = (unsigned char)v;
+            flags &= ~(TERM_F_PLUS | TERM_F_SPACE);
+            if (c == 'X') flags |= TERM_F_UPPER;
+            term_put_num(term, v, false, c == 'u' ? 10 : c == 'o' ? 8 : 16, flags, width, prec);
+            break;
+        case 'p':
+            v = (uint64_t)(uintptr_t)va_arg(ap, void *);
+            flags &= ~(TERM_F_PLUS | TERM_F_SPACE);
+            term_put_num(term, v, false, 16, flags | TERM_F_ALT, width, prec);
+            break;
+        case 'c': {
+            char ch = (char)va_arg(ap, int);
+            uint32_t pad = width > 1 ? width - 1 : 0;
+            if (!(flags & TERM_F_LEFT)) term_pad(term, ' ', pad);
+            term_write(term, &ch, 1);
+            if (flags & TERM_F_LEFT) term_pad(term, ' ', pad);
+            break;
+        }
+        case 's':
+            term_put_str(term, va_arg(ap, const char *), flags, width, prec);
+            break;
+        case '%':
+            term_write(term, "%", 1);
+            break;
+        default:
+            // unknown, print it as it was
+            term_write(term, spec, (uint64_t)(p - spec));
+            break;
+        }
+    }
+}
+
+void cuoreterm_vprintf(struct terminal *term, const char *fmt, va_list ap) {
+    term_vprintf(term, fmt, ap);
+    if (!term->deferred) term_present(term);
+}
+
+void cuoreterm_printf(struct terminal *term, const char *fmt, ...) {
+    va_list ap;
+    va_start(ap, fmt);
+    term_vprintf(term, fmt, ap);
+    va_end(ap);
+    if (!term->deferred) term_present(term);
+}
+
+void cuoreterm_write_str(struct terminal *term, const char *s) {
+    term_put_str(term, s, 0, 0, -1);
+    if (!term->deferred) term_present(term);
+}
+
+void cuoreterm_write_dec(struct terminal *term, int64_t v) {
+    term_put_num(term, v < 0 ? 0 - (uint64_t)v : (uint64_t)v, v < 0, 10, 0, 0, -1);
+    if (!term->deferred) term_present(term);
+}
+
+void cuoreterm_write_hex(struct terminal *term, uint64_t v, uint32_t digits) {
+    term_put_num(term, v, false, 16, TERM_F_ZERO, digits, -1);
+    if (!term->deferred) term_present(term);
+}
+
+// record header: payload length plus flags, records start 4 byte aligned and never wrap
+#define TERM_Q_READY (1u << 31)
+#define TERM_Q_PAD   (1u << 30) // filler up to the end of the ring, length is the whole record
+#define TERM_Q_LEN   (TERM_Q_PAD - 1)
+
+static inline uint32_t term_q_record(uint32_t len) {
+    return (4 + len + 3) & ~3u;
+}
+
+void cuoreterm_queue_init(struct cuoreterm_queue *q, void *buf, uint32_t size) {
+    // ring offsets are masked with size - 1
+    while (size & (size - 1)) size &= size - 1;
+    if (size < 8) size = 0;
+
+    q->buf = (uint8_t*)buf;
+    q->size = size;
+    q->dropped = 0;
+    q->reserve = 0;
+    q->tail = 0;
+    h_memset(buf, 0x00, size);
+}
+
+void cuoreterm_queue_write(void *ctx, const char *msg, uint64_t len) {
+    struct cuoreterm_queue *q = (struct cuoreterm_queue *)ctx;
+    uint32_t mask = q->size - 1;
+
+    // a record of at most half the ring fits an empty one wherever the filler in front of it ends
+    uint32_t need = len <= q->size / 2 ? term_q_record((uint32_t)len) : UINT32_MAX;
+    if (need > q->size / 2) { __atomic_fetch_add(&q->dropped, 1, __ATOMIC_RELAXED); return; }
+    uint32_t pos = __atomic_load_n(&q->reserve, __ATOMIC_RELAXED);
+    uint32_t pad;
+
+    // claim the record plus any filler in front of it in one go
+    do {
+        uint32_t off = pos & mask;
+        pad = (off + need > q->size) ? q->size - off : 0;
+
+        uint32_t tail = __atomic_load_n(&q->tail, __ATOMIC_ACQUIRE);
+        if (pos + pad + need - tail > q->size) { __atomic_fetch_add(&q->dropped, 1, __ATOMIC_RELAXED); return; }
+    } while (!__atomic_compare_exchange_n(&q->reserve, &pos, pos + pad + need, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+
+    if (pad) __atomic_store_n((uint32_t*)(q->buf + (pos & mask)), TERM_Q_READY | TERM_Q_PAD | pad, __ATOMIC_RELEASE);
+
+    uint8_t *rec = q->buf + ((pos + pad) & mask);
+    for (uint32_t i = 0; i < len; i++) rec[4 + i] = (uint8_t)msg[i];
+
+    __atomic_store_n((uint32_t*)rec, TERM_Q_READY | (uint32_t)len, __ATOMIC_RELEASE);
+}
+
+uint32_t cuoreterm_queue_drain(struct cuoreterm_queue *q, struct terminal *term) {
+    uint32_t mask = q->size - 1;
+    uint32_t tail = q->tail;
+    uint32_t n = 0;
+
+    if (!q->size) return 0;
+
+    // stop at the first record still being filled in, its producer publishes it later
+    for (;;) {
+        uint32_t *hdr = (uint32_t*)(q->buf + (tail & mask));
+        uint32_t w = __atomic_load_n(hdr, __ATOMIC_ACQUIRE);
+        if (!(w & TERM_Q_READY)) break;
+
+        uint32_t size = w & TERM_Q_LEN;
+        if (!(w & TERM_Q_PAD)) {
+            term_write(term, (const char*)(hdr + 1), size);
+            size = term_q_record(size);
+            n++;
+        }
+
+        // zero what we read so stale bytes never look like a ready header once the ring wraps
+        h_memset(hdr, 0x00, size);
+        tail += size;
+        __atomic_store_n(&q->tail, tail, __ATOMIC_RELEASE);
+    }
+
+    if (n && !term->deferred) term_present(term);
+    return n;
+}
+
+#define TERM_PSF2_MAGIC 0x864AB572u
+#define TERM_NO_GLYPH   0xFFFF
+
+static inline uint32_t term_le32(const uint8_t *p) {
+    return p[0] | (p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+// next codepoint of a glyph's entry in the font's unicode table, 0xFFFF ends the entry and 0xFFFE
+// starts the combining sequences at its end. psf2 spells them as single 0xFF / 0xFE bytes in its utf-8.
+// past end (unless it is NULL) every entry is empty
+static uint32_t term_font_table_next(const uint8_t **pp, const uint8_t *end, bool utf8) {
+    const uint8_t *p = *pp;
+    uint32_t cp;
+
+    if (end && end - p < (utf8 ? 1 : 2)) return 0xFFFF;
+
+    if (!utf8) {
+        cp = p[0] | (p[1] << 8);
+        p += 2;
+    } else {
+        uint8_t c = *p++;
+        uint32_t need = c >= 0xF0 ? 3 : c >= 0xE0 ? 2 : c >= 0xC0 ? 1 : 0;
+
+        if (c == 0xFF) cp = 0xFFFF;
+        else if (c == 0xFE) cp = 0xFFFE;
+        else cp = need ? c & (0x3Fu >> need) : c;
+        if (c < 0xFE)
+            for (; need && (!end || p < end) && (*p & 0xC0) == 0x80; need--) cp = (cp << 6) | (*p++ & 0x3F);
+    }
+
+    *pp = p;
+    return cp;
+}
+
+// true when the table holds an entry for each of count glyphs before end
+static bool term_font_table_ok(const uint8_t *p, const uint8_t *end, uint32_t count, bool utf8) {
+    for (uint32_t g = 0; g < count; g++) {
+        for (;;) {
+            if (end - p < (utf8 ? 1 : 2)) return false;
+            if (utf8 ? *p++ == 0xFF : (p += 2, p[-2] == 0xFF && p[-1] == 0xFF)) break;
+        }
+    }
+    return true;
+}
+
+// fill font_map from the font's unicode table, a codepoint listed for several glyphs gets the first
+static void term_build_font_map(struct terminal *term) {
+    uint16_t *map = term->font_map_buf;
+    uint32_t size = term->font_map_cap;
+    uint32_t count = term->glyph_count < TERM_NO_GLYPH ? term->glyph_count : TERM_NO_GLYPH;
+    uint32_t fffd = TERM_NO_GLYPH;
+
+    for (uint32_t cp = 0; cp < size; cp++) map[cp] = TERM_NO_GLYPH;
+
+    if (term->font_table) {
+        const uint8_t *p = term->font_table;
+
+        for (uint32_t g = 0; g < count; g++) {
+            bool seq = false;
+            for (;;) {
+                uint32_t cp = term_font_table_next(&p, term->font_end, term->font_table_utf8);
+                if (cp == 0xFFFF) break;
+                if (cp == 0xFFFE) seq = true;
+                if (seq) continue; // a single cell can only show a single codepoint
+
+                if (cp < size && map[cp] == TERM_NO_GLYPH) map[cp] = (uint16_t)g;
+                if (cp == 0xFFFD && fffd == TERM_NO_GLYPH) fffd = g;
+            }
+        }
+
+        // control characters the table leaves out draw whatever is in their slot, as without a table
+        for (uint32_t cp = 0; cp < 0x80 && cp < count; cp++)
+            if ((cp < 0x20 || cp == 0x7F) && map[cp] == TERM_NO_GLYPH) map[cp] = (uint16_t)cp;
+    } else {
+        for (uint32_t cp = 0; cp < size && cp < count; cp++) map[cp] = (uint16_t)cp;
+    }
+
+    if (fffd == TERM_NO_GLYPH) fffd = map['?'] != TERM_NO_GLYPH ? map['?'] : 0;
+    term->font_missing = (uint16_t)fffd;
+
+    for (uint32_t cp = 0; cp < size; cp++)
+        if (map[cp] == TERM_NO_GLYPH) map[cp] = (uint16_t)fffd;
+
+    term->font_map = map;
+    term->font_map_size = size;
+}
+
+// glyphs clipped to the cell, before scaling
+static inline uint32_t term_clip_w(const struct terminal *term) { return term->font_glyph_w < term->cell_w ? term->font_glyph_w : term->cell_w; }
+static inline uint32_t term_clip_h(const struct terminal *term) { return term->font_glyph_h < term->cell_h ? term->font_glyph_h : term->cell_h; }
+
+uint32_t cuoreterm_scale_atlas_size(struct terminal *term, uint32_t scale) {
+    return term->glyph_count * ((term_clip_w(term) * scale + 7) / 8) * term_clip_h(term) * scale;
+}
+
+// every glyph with each bit widened to scale bits and each row repeated scale times
+static void term_build_atlas(struct terminal *term, uint32_t s, uint32_t stride) {
+    uint32_t gw = term_clip_w(term), gh = term_clip_h(term);
+    uint8_t *out = term->atlas;
+
+    for (uint32_t g = 0; g < term->glyph_count; g++) {
+        const uint8_t *src = term->font_bits + g * term->font_bytes;
+        for (uint32_t r = 0; r < gh; r++, src += term->font_stride, out += s * stride) {
+            h_memset(out, 0x00, stride);
+            for (uint32_t x = 0; x < gw; x++) {
+                if (!(src[x >> 3] & (0x80 >> (x & 7)))) continue;
+                for (uint32_t k = x * s; k < x * s + s; k++) out[k >> 3] |= (uint8_t)(0x80 >> (k & 7));
+            }
+            for (uint32_t k = 1; k < s; k++) h_memmove(out + k * stride, out, stride);
+        }
+    }
+}
+
+// take up the compiled font's pixels while the terminal draws in their format at 1x
+static void term_font_pixels_check(struct terminal *term) {
+    const struct cuoreterm_font *f = term->font_compiled;
+
+    term->font_pixels = 0;
+    if (f && f->pixels && term->scale == 1 && term_same_format(&f->pixel_fmt, &term->fmt)) {
+        term->font_pixels = f->pixels;
+        term->font_pixels_fg = term_pack(&term->fmt, f->pixel_fg);
+        term->font_pixels_bg = term_pack(&term->fmt, f->pixel_bg);
+    }
+}
+
+// size the cells for scale and point drawing at the font or its atlas, 1x if the atlas is missing or short
+static void term_font_layout(struct terminal *term, uint32_t scale) {
+    if (!term->cell_w) return; // no font yet, setting one lays it out
+
+    if (scale > 1 && term->atlas && cuoreterm_scale_atlas_size(term, scale) <= term->atlas_size) {
+        uint32_t stride = (term_clip_w(term) * scale + 7) / 8;
+        term_build_atlas(term, scale, stride);
+        term->font_glyphs = term->atlas;
+        term->glyph_stride = stride;
+        term->glyph_bytes = stride * term_clip_h(term) * scale;
+    } else {
+        scale = 1;
+        term->font_glyphs = term->font_bits;
+        term->glyph_stride = term->font_stride;
+        term->glyph_bytes = term->font_bytes;
+    }
+
+    term->scale = scale;
+    term->font_width = term->cell_w * scale;
+    term->font_height = term->cell_h * scale;
+    term->glyph_w = term_clip_w(term) * scale;
+    term->glyph_h = term_clip_h(term) * scale;
+    term->cols = term->fb_width / term->font_width;
+    term->rows = term->fb_height / term->font_height;
+
+    term_font_pixels_check(term);
+    term_gcache_reset(term);
+
+    // cols changed under the grid so whatever it held no longer lines up
+    term_grid_reset(term);
+    term_region_reset(term);
+}
+
+bool cuoreterm_set_font_sized(struct terminal *term, const uint8_t *font, uint32_t size, uint32_t font_w, uint32_t font_h) {
+    // anything that is not psf2 is taken as psf1, font_h rows of one byte if the magic is missing too
+    uint32_t w = 8, h = font_h, count = 256, hdr = 4, bytes = font_h;
+    bool has_table = false, utf8 = false;
+
+    if (size && size < 4) return false;
+
+    if (term_le32(font) == TERM_PSF2_MAGIC) {
+        if (size && size < 32) return false;
+        hdr = term_le32(font + 8);
+        count = term_le32(font + 16);
+        bytes = term_le32(font + 20);
+        h = term_le32(font + 24);
+        w = term_le32(font + 28);
+        has_table = utf8 = term_le32(font + 12) & 1;
+        if (hdr < 32 || !w || w > 0xFFFF) return false;
+    } else if (font[0] == 0x36 && font[1] == 0x04) {
+        h = bytes = font[3];
+        if (font[2] & 0x01) count = 512;
+        has_table = font[2] & 0x06;
+    }
+
+    // glyphs have to hold their rows and, with a size, everything has to be inside it
+    uint64_t glyphs_end = hdr + (uint64_t)count * bytes;
+    if (!count || !h || (uint64_t)bytes < (uint64_t)((w + 7) / 8) * h) return false;
+    if (size ? glyphs_end > size : glyphs_end > UINT32_MAX) return false;
+    if (size && has_table && !term_font_table_ok(font + glyphs_end, font + size, count, utf8)) return false;
+
+    term->font_data = font;
+    term->font_compiled = 0;
+    term->font_bits = font + hdr;
+    term->font_table = has_table ? font + glyphs_end : 0;
+    term->font_end = size ? font + size : 0;
+    term->font_table_utf8 = utf8;
+    term->glyph_count = count;
+    term->font_glyph_w = w;
+    term->font_glyph_h = h;
+    term->font_stride = (w + 7) / 8;
+    term->font_bytes = bytes;
+    term->cell_w = font_w ? font_w : w;
+    term->cell_h = font_h ? font_h : h;
+
+    term_build_font_map(term);
+    term_font_layout(term, term->scale);
+    return true;
+}
+
+void cuoreterm_set_font(struct terminal *term, const uint8_t *font, uint32_t font_w, uint32_t font_h) {
+    cuoreterm_set_font_sized(term, font, 0, font_w, font_h);
+}
+
+void cuoreterm_set_compiled_font(struct terminal *term, const struct cuoreterm_font *font) {
+    term->font_data = 0;
+    term->font_compiled = font;
+    term->font_bits = font->glyphs;
+    term->font_table = 0;
+    term->font_table_utf8 = false;
+    term->glyph_count = font->glyph_count;
+    term->font_glyph_w = term->cell_w = font->glyph_w;
+    term->font_glyph_h = term->cell_h = font->glyph_h;
+    term->font_stride = font->stride;
+    term->font_bytes = font->glyph_bytes;
+    term->font_map = font->map;
+    term->font_map_size = font->map_size;
+    term->font_missing = font->missing;
+
+    term_font_layout(term, term->scale);
+}
+
+bool cuoreterm_set_scale(struct terminal *term, uint32_t scale, void *atlas, uint32_t size) {
+    term->atlas = (uint8_t*)atlas;
+    term->atlas_size = size;
+    term_font_layout(term, scale ? scale : 1);
+    return term->scale == (scale ? scale : 1);
+}
+
+// point the fb, shadow and drawing at the pane's corner
+static void term_pane_addr(struct terminal *term) {
+    uint32_t off = term->pane_y * term->fb_pitch + term->pane_x * term->pixel_bytes;
+
+    term->fb_addr = (uint8_t*)term->screen_fb + off;
+    term->shadow_addr = term->screen_shadow ? (uint8_t*)term->screen_shadow + off : 0;
+    term->draw_addr = term->shadow_addr ? term->shadow_addr : term->fb_addr;
+    term_pick_glyph_kernels(term, term_cpu_features());
+}
+
+void cuoreterm_set_pane(struct terminal *term, uint32_t x, uint32_t y, uint32_t w, uint32_t h) {
+    if (x > term->screen_width) x = term->screen_width;
+    if (y > term->screen_height) y = term->screen_height;
+    if (w > term->screen_width - x) w = term->screen_width - x;
+    if (h > term->screen_height - y) h = term->screen_height - y;
+
+    term->pane_x = x;
+    term->pane_y = y;
+    term->fb_width = w;
+    term->fb_height = h;
+    term_pane_addr(term);
+    term->dirty_x0 = term->dirty_y0 = UINT32_MAX;
+    term->dirty_x1 = term->dirty_y1 = 0;
+
+    if (term->font_width) term_font_layout(term, term->scale);
+}
+
+// every channel has to fit the pixel and the packing/unpacking math (1-16 bits)
+static bool term_format_ok(const struct cuoreterm_format *f) {
+    uint32_t bits = ((f->bpp + 7) / 8) * 8;
+    if (!f->bpp || f->bpp > 32) return false;
+
+    return f->r_size >= 1 && f->r_size <= 16 && f->r_shift + f->r_size <= bits &&
+           f->g_size >= 1 && f->g_size <= 16 && f->g_shift + f->g_size <= bits &&
+           f->b_size >= 1 && f->b_size <= 16 && f->b_shift + f->b_size <= bits;
+}
+
+bool cuoreterm_set_format(struct terminal *term, const struct cuoreterm_format *fmt) {
+    if (!term_format_ok(fmt)) return false;
+
+    term->fmt = *fmt;
+    term->fb_bpp = fmt->bpp;
+    term->pixel_bytes = (fmt->bpp + 7) / 8;
+    term_pane_addr(term); // picks the glyph kernels for the new pixel size too
+    term->ops = term_pick_ops(term->pixel_bytes);
+    term_build_palette(term);
+    term_font_pixels_check(term);
+    term_gcache_reset(term);
+    term_prev_forget(term, 0, term->rows);
+    return true;
+}
+
+bool cuoreterm_add_head(struct terminal *term, void *fb_addr, uint32_t width, uint32_t height, uint32_t pitch,
+                        const struct cuoreterm_format *fmt) {
+    if (!term->shadow_addr || term->nheads >= CUORETERM_MAX_HEADS || !term_format_ok(fmt)) return false;
+
+    struct cuoreterm_head *h = &term->heads[term->nheads++];
+    h->addr = fb_addr;
+    h->width = width;
+    h->height = height;
+    h->pitch = pitch;
+    h->fmt = *fmt;
+    h->pixel_bytes = (fmt->bpp + 7) / 8;
+
+    // bring it up to date with what is already on screen
+    term_damage(term, 0, 0, term->fb_width, term->fb_height);
+    return true;
+}
+
+uint32_t cuoreterm_glyph_cache_slot_size(struct terminal *term) {
+    uint32_t glyphs = term->glyph_count < CUORETERM_GLYPH_CACHE_GLYPHS ? term->glyph_count : CUORETERM_GLYPH_CACHE_GLYPHS;
+    return glyphs * term->font_height * term->font_width * term->pixel_bytes;
+}
+
+void cuoreterm_set_font_map(struct terminal *term, uint16_t *map, uint32_t entries) {
+    if (map && entries > 256) {
+        term->font_map_buf = map;
+        term->font_map_cap = entries;
+    } else {
+        term->font_map_buf = term->font_low;
+        term->font_map_cap = 256;
+    }
+    if (term->font_compiled) return; // it brings its own, this one is for the next psf font
+
+    term_build_font_map(term);
+    term_prev_forget(term, 0, term->rows);
+}
+
+void cuoreterm_set_opaque(struct terminal *term, bool on) {
+    term->opaque = on;
+}
+
+void cuoreterm_set_glyph_cache(struct terminal *term, void *buf, uint32_t size) {
+    term->gcache = (uint8_t*)buf;
+    term->gcache_size = size;
+    term_gcache_reset(term);
+}
+
+void cuoreterm_set_grid_diff(struct terminal *term, struct cuoreterm_cell *prev, uint32_t count) {
+    term->prev = term->cells && count >= term->cols * term->rows ? prev : 0;
+    term->prev_cap = term->prev ? count : 0;
+    term_prev_forget(term, 0, term->rows);
+}
+
+void cuoreterm_set_scrollback(struct terminal *term, void *buf, uint32_t size) {
+    term->sb = (uint8_t*)buf;
+    term->sb_size = buf ? size & ~3u : 0;
+    term_sb_reset(term);
+}
+
+uint32_t cuoreterm_scrollback_lines(struct terminal *term) {
+    return term->sb ? term->sb_lines : 0;
+}
+
+uint32_t cuoreterm_scrollback_bytes(struct terminal *term) {
+    return term->sb ? term->sb_used : 0;
+}
+
+void cuoreterm_set_view(struct terminal *term, uint32_t lines_back) {
+    uint32_t max = term->sb ? term->sb_lines : 0;
+    if (lines_back > max) lines_back = max;
+
+    if (lines_back != term->sb_view) {
+        term->sb_view = lines_back;
+        term->view_redraw = true;
+    }
+    if (!term->deferred) term_present(term);
+}
+
+void cuoreterm_scroll_view(struct terminal *term, int32_t lines) {
+    int64_t v = (int64_t)term->sb_view + lines;
+    cuoreterm_set_view(term, v < 0 ? 0 : (v > UINT32_MAX ? UINT32_MAX : (uint32_t)v));
+}
+
+void cuoreterm_set_grid(struct terminal *term, struct cuoreterm_cell *cells, uint32_t count) {
+    term->cells = cells;
+    term->grid_cap = count;
+    if (!term->font_height) return; // sized when a font is set
+
+    term->rows = term->fb_height / term->font_height;
+    term_grid_reset(term);
+    term_region_reset(term);
+}
+
+void cuoreterm_clear(struct terminal *term) {
+    TERM_STAT_START(t0);
+
+    // clear both buffers directly, a flush would have to copy the same zeros across. a pane only its rect
+    uint32_t span = term_pane_span(term);
+    bool whole = span == term->fb_pitch && term->pane_y == 0 && term->fb_height == term->screen_height;
+
+    if (term->shadow_addr) term_fill_rect(term, false, (uint8_t*)term->shadow_addr, term->fb_pitch, span, term->fb_height);
+    term_fill_rect(term, true, (uint8_t*)term->fb_addr, term->fb_pitch, span, term->fb_height);
+    for (uint32_t i = 0; i < term->nheads; i++) {
+        struct cuoreterm_head *h = &term->heads[i];
+        if (whole) { term_fb_fill(term, true, h->addr, 0x00, h->pitch * h->height); continue; }
+        if (term->pane_x >= h->width || term->pane_y >= h->height) continue;
+
+        uint32_t w = h->width - term->pane_x < term->fb_width ? h->width - term->pane_x : term->fb_width;
+        uint32_t rows = h->height - term->pane_y < term->fb_height ? h->height - term->pane_y : term->fb_height;
+        term_fill_rect(term, true, (uint8_t*)h->addr + term->pane_y * h->pitch + term->pane_x * h->pixel_bytes, h->pitch,
+                       w * h->pixel_bytes, rows);
+    }
+    term_store_fence();
+    term_grid_reset(term);
+    if (term->prev) h_memset(term->prev, 0x00, term->cols * term->rows * sizeof(struct cuoreterm_cell)); // empty is black
+    term->cursor_x = 0;
+    term->cursor_y = 0;
+    term->sb_view = 0; // the history stays, the screen is live again
+
+    TERM_STAT_ADD(term, fb_written, (uint64_t)span * term->fb_height);
+    TERM_STAT_CYCLES(term, cycles_clear, t0);
+}
+
+// where each buffer cfg asks for goes in the arena, offsets from its aligned start
+struct term_arena {
+    uint64_t cells, prev, gcache, atlas, map, sb, shadow, end;
+    uint32_t ncells, gcache_size, atlas_size, scale;
+};
+
+static inline uint64_t term_arena_take(uint64_t *at, uint64_t bytes) {
+    uint64_t off = *at;
+    *at = (off + bytes + 63) & ~63ull;
+    return off;
+}
+
+// the terminal as cfg has it before any buffers, so its geometry can be planned around
+// false when cfg->font or cfg->fmt is rejected
+static bool term_arena_setup(struct terminal *term, const struct cuoreterm_config *cfg) {
+    cuoreterm_init(term, cfg->fb_addr, cfg->fb_width, cfg->fb_height, cfg->fb_pitch, cfg->fb_bpp, 0, 0, 0);
+    if (cfg->compiled) cuoreterm_set_compiled_font(term, cfg->compiled);
+    else if (cfg->font && !cuoreterm_set_font_sized(term, cfg->font, cfg->font_size, cfg->font_w, cfg->font_h)) return false;
+    if (cfg->fmt && !cuoreterm_set_format(term, cfg->fmt)) return false;
+    if (cfg->pane_w) cuoreterm_set_pane(term, cfg->pane_x, cfg->pane_y, cfg->pane_w, cfg->pane_h);
+    return true;
+}
+
+// sizes come from the cell at the final scale, the same sums set_grid and the glyph cache do
+static void term_arena_plan(struct terminal *term, const struct cuoreterm_config *cfg, struct term_arena *a) {
+    uint32_t scale = cfg->scale > 1 ? cfg->scale : 1;
+    uint32_t fw = term->cell_w * scale, fh = term->cell_h * scale;
+    uint32_t glyphs = term->glyph_count < CUORETERM_GLYPH_CACHE_GLYPHS ? term->glyph_count : CUORETERM_GLYPH_CACHE_GLYPHS;
+    uint32_t slots = cfg->glyph_cache < CUORETERM_GLYPH_CACHE_SLOTS ? cfg->glyph_cache : CUORETERM_GLYPH_CACHE_SLOTS;
+    uint64_t at = 0;
+
+    h_memset(a, 0x00, sizeof(*a));
+    a->scale = scale;
+    if (!term->font_width) return; // no font, nothing to size
+
+    if (cfg->grid && fw && fh) a->ncells = (term->fb_width / fw) * (term->fb_height / fh);
+    a->gcache_size = slots * glyphs * fh * fw * term->pixel_bytes;
+    a->atlas_size = scale > 1 ? cuoreterm_scale_atlas_size(term, scale) : 0;
+
+    // what every present walks first, then what is touched now and then
+    a->cells = term_arena_take(&at, (uint64_t)a->ncells * sizeof(struct cuoreterm_cell));
+    a->prev = term_arena_take(&at, cfg->grid_diff ? (uint64_t)a->ncells * sizeof(struct cuoreterm_cell) : 0);
+    a->gcache = term_arena_take(&at, a->gcache_size);
+    a->atlas = term_arena_take(&at, a->atlas_size);
+    a->map = term_arena_take(&at, cfg->font_map > 256 ? (uint64_t)cfg->font_map * sizeof(uint16_t) : 0);
+    a->sb = term_arena_take(&at, a->ncells ? cfg->scrollback & ~3u : 0);
+    a->shadow = term_arena_take(&at, cfg->shadow ? (uint64_t)term->fb_pitch * term->screen_height : 0);
+    a->end = at;
+}
+
+uint64_t cuoreterm_required_memory(const struct cuoreterm_config *cfg) {
+    struct terminal term;
+    struct term_arena a;
+
+    if (!term_arena_setup(&term, cfg)) return 0;
+    term_arena_plan(&term, cfg, &a);
+    return a.end;
+}
+
+bool cuoreterm_init_arena(struct terminal *term, const struct cuoreterm_config *cfg, void *arena, uint64_t size) {
+    struct term_arena a;
+
+    if (!term_arena_setup(term, cfg)) return false;
+    term_arena_plan(term, cfg, &a);
+
+    uint8_t *base = (uint8_t*)(((uintptr_t)arena + 63) & ~(uintptr_t)63);
+    if (a.end && (!arena || a.end + (uint64_t)(base - (uint8_t*)arena) > size)) return false;
+
+    // scale first, the cols and rows everything else is sized for follow from it
+    if (a.atlas_size) cuoreterm_set_scale(term, a.scale, base + a.atlas, a.atlas_size);
+    if (cfg->font_map > 256) cuoreterm_set_font_map(term, (uint16_t*)(base + a.map), cfg->font_map);
+    if (cfg->shadow) {
+        term->screen_shadow = base + a.shadow;
+        term_pane_addr(term);
+    }
+    if (a.ncells) {
+        cuoreterm_set_grid(term, (struct cuoreterm_cell*)(base + a.cells), a.ncells);
+        if (cfg->grid_diff) cuoreterm_set_grid_diff(term, (struct cuoreterm_cell*)(base + a.prev), a.ncells);
+        if (cfg->scrollback >= 4) cuoreterm_set_scrollback(term, base + a.sb, cfg->scrollback);
+    }
+    if (a.gcache_size) cuoreterm_set_glyph_cache(term, base + a.gcache, a.gcache_size);
+    return true;
+}
+
+#ifdef CUORETERM_STATS
+void cuoreterm_get_stats(struct terminal *term, struct cuoreterm_stats *out) {
+    *out = term->stats;
+}
+
+void cuoreterm_reset_stats(struct terminal *term) {
+    h_memset(&term->stats, 0x00, sizeof(term->stats));
+}
+#endif
+
 #endif // CUORETERM_IMPL
 #endif // CUORETERM_H
@@ -0,0 +1,226 @@
+// hosted benchmark for Cuoreterm.h on a 1920x1080 malloc'd framebuffer, best of a few runs per mode:
+// text workloads in ns per byte, glyphs per second and rdtsc cycles per glyph, clears in bytes per second
+// and one line scrolls in ns each
+//
+//   ./bench_cuoreterm [runs] [bpp]    defaults 5 and 32
+#define CUORETERM_IMPL
+#include "Cuoreterm.h"
+#include "kfont.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#ifdef __x86_64__
+#include <x86intrin.h>
+#define RDTSC() __rdtsc()
+#else
+#define RDTSC() 0ull
+#endif
+
+#define W 1920
+#define H 1080
+#define CLEARS 50
+#define SCROLLS 500
+
+enum { M_PIXEL, M_OPAQUE, M_SHADOW, M_GRID, M_DEFERRED, MODES };
+static const char *mode_names[MODES] = { "pixel", "opaque", "shadow", "grid", "deferred" };
+
+enum { B_LOG, B_REDRAW, B_BIG, BENCHES };
+static const char *bench_names[BENCHES] = { "log", "redraw", "big" };
+
+struct setup {
+    struct terminal term;
+    uint8_t *fb, *shadow;
+    struct cuoreterm_cell *cells;
+};
+
+static void setup_mode(struct setup *s, uint32_t bpp, int mode) {
+    uint32_t pitch = W * ((bpp + 7) / 8);
+    memset(s, 0, sizeof(*s));
+    s->fb = calloc(pitch, H);
+    if (mode == M_SHADOW || mode == M_DEFERRED) {
+        s->shadow = calloc(pitch, H);
+        cuoreterm_init_shadow(&s->term, s->fb, W, H, pitch, bpp, s->shadow, iso10_f14_psf, 8, 14);
+    } else {
+        cuoreterm_init(&s->term, s->fb, W, H, pitch, bpp, iso10_f14_psf, 8, 14);
+    }
+
+    struct terminal *t = &s->term;
+    if (mode == M_OPAQUE) cuoreterm_set_opaque(t, true);
+    if (mode == M_GRID || mode == M_DEFERRED) {
+        uint32_t n = t->cols * t->rows;
+        s->cells = malloc(n * sizeof(struct cuoreterm_cell));
+        cuoreterm_set_grid(t, s->cells, n);
+    }
+    if (mode == M_DEFERRED) cuoreterm_set_deferred(t, true);
+    cuoreterm_clear(t);
+}
+
+static void setup_free(struct setup *s) {
+    free(s->fb);
+    free(s->shadow);
+    free(s->cells);
+}
+
+// log: short coloured lines one write each, scrolling all the way. redraw: a full screen program
+// homing the cursor and repainting every row. big: the whole log in a single write
+static char log_buf[1 << 20], redraw_buf[1 << 18];
+static uint32_t log_len, redraw_len, log_lines;
+
+static void build_workloads(void) {
+    for (uint32_t i = 0; log_len + 128 < sizeof(log_buf) && i < 4000; i++, log_lines++)
+        log_len += (uint32_t)snprintf(log_buf + log_len, sizeof(log_buf) - log_len,
+                                      "[%6u.%03u] \x1b[3%um%s\x1b[0m: probe at %#x done, %u bytes\n",
+                                      i / 1000, i % 1000, 1 + i % 7, i % 3 ? "pci" : "ahci", i * 0x1000, i * 37);
+
+    redraw_len = (uint32_t)snprintf(redraw_buf, sizeof(redraw_buf), "\x1b[H");
+    for (uint32_t r = 1; r <= 77; r++) {
+        redraw_len += (uint32_t)snprintf(redraw_buf + redraw_len, sizeof(redraw_buf) - redraw_len, "\x1b[%u;1H\x1b[4%u;97m", r, r % 8);
+        for (uint32_t c = 0; c < 240; c++) redraw_buf[redraw_len++] = (char)('!' + (r * 7 + c) % 94);
+    }
+    redraw_len += (uint32_t)snprintf(redraw_buf + redraw_len, sizeof(redraw_buf) - redraw_len, "\x1b[0m");
+}
+
+// printable bytes outside escape sequences, what the workloads put in cells
+static uint64_t count_glyphs(const char *p, uint32_t n) {
+    uint64_t g = 0;
+    for (uint32_t i = 0; i < n; i++) {
+        if (p[i] == 0x1B) {
+            for (i += 2; i < n && (p[i] < 0x40 || p[i] > 0x7E); i++);
+            continue;
+        }
+        g += (uint8_t)p[i] >= 0x20;
+    }
+    return g;
+}
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+struct result {
+    uint64_t ns, cycles, bytes, glyphs;
+};
+
+// one run of a text workload
+static struct result run_bench(int bench, uint32_t bpp, int mode) {
+    struct setup s;
+    struct result r = { 0 };
+    setup_mode(&s, bpp, mode);
+    struct terminal *t = &s.term;
+
+    uint64_t t0 = now_ns(), c0 = RDTSC();
+    switch (bench) {
+        case B_LOG: {
+            const char *p = log_buf;
+            for (uint32_t i = 0; i < log_lines; i++) {
+                const char *nl = memchr(p, '\n', (size_t)(log_buf + log_len - p));
+                cuoreterm_write(t, p, (uint64_t)(nl + 1 - p));
+                p = nl + 1;
+            }
+            r.bytes = log_len;
+            r.glyphs = count_glyphs(log_buf, log_len);
+            break;
+        }
+        case B_REDRAW:
+            for (int i = 0; i < 20; i++) cuoreterm_write(t, redraw_buf, redraw_len);
+            r.bytes = (uint64_t)redraw_len * 20;
+            r.glyphs = count_glyphs(redraw_buf, redraw_len) * 20;
+            break;
+        case B_BIG:
+            cuoreterm_write(t, log_buf, log_len);
+            r.bytes = log_len;
+            r.glyphs = count_glyphs(log_buf, log_len);
+            break;
+    }
+    if (mode == M_DEFERRED) cuoreterm_present(t);
+    r.cycles = RDTSC() - c0;
+    r.ns = now_ns() - t0;
+
+    setup_free(&s);
+    return r;
+}
+
+// ns for CLEARS whole screen clears, each on screen before the next
+static uint64_t run_clears(uint32_t bpp, int mode) {
+    struct setup s;
+    setup_mode(&s, bpp, mode);
+
+    uint64_t t0 = now_ns();
+    for (int i = 0; i < CLEARS; i++) {
+        cuoreterm_clear(&s.term);
+        cuoreterm_present(&s.term);
+    }
+    uint64_t ns = now_ns() - t0;
+
+    setup_free(&s);
+    return ns;
+}
+
+// ns for SCROLLS one line scrolls of a full screen, each on screen before the next
+static uint64_t run_scrolls(uint32_t bpp, int mode) {
+    struct setup s;
+    setup_mode(&s, bpp, mode);
+    struct terminal *t = &s.term;
+
+    // fill every row so each scroll moves real text
+    for (uint32_t y = 0; y < t->rows; y++) {
+        for (uint32_t x = 0; x + 1 < t->cols; x++) cuoreterm_write(t, &"scrolling text "[x % 15], 1);
+        cuoreterm_write(t, "\n", 1);
+    }
+    cuoreterm_present(t);
+
+    uint64_t t0 = now_ns();
+    for (int i = 0; i < SCROLLS; i++) {
+        cuoreterm_write(t, "\n", 1);
+        cuoreterm_present(t);
+    }
+    uint64_t ns = now_ns() - t0;
+
+    setup_free(&s);
+    return ns;
+}
+
+int main(int argc, char **argv) {
+    int runs = argc > 1 ? atoi(argv[1]) : 5;
+    uint32_t bpp = argc > 2 ? (uint32_t)atoi(argv[2]) : 32;
+    if (runs < 1 || (bpp != 8 && bpp != 16 && bpp != 24 && bpp != 32)) {
+        fprintf(stderr, "usage: bench_cuoreterm [runs] [8|16|24|32]\n");
+        return 1;
+    }
+
+    build_workloads();
+    uint64_t screen = (uint64_t)W * ((bpp + 7) / 8) * H;
+    printf("%ux%ux%u, best of %d\n\n", W, H, bpp, runs);
+
+    for (int b = 0; b < BENCHES; b++) {
+        printf("%-10s %10s %12s %12s\n", bench_names[b], "ns/byte", "Mglyphs/s", "cycles/glyph");
+        for (int m = 0; m < MODES; m++) {
+            struct result best = { UINT64_MAX, 0, 1, 1 };
+            for (int r = 0; r < runs; r++) {
+                struct result res = run_bench(b, bpp, m);
+                if (res.ns < best.ns) best = res;
+            }
+            printf("%-10s %10.2f %12.2f %12.1f\n", mode_names[m], (double)best.ns / (double)best.bytes,
+                   (double)best.glyphs * 1e3 / (double)best.ns, (double)best.cycles / (double)best.glyphs);
+        }
+        printf("\n");
+    }
+
+    printf("%-10s %10s %12s\n", "screen", "clear GB/s", "scroll us");
+    for (int m = 0; m < MODES; m++) {
+        uint64_t clear = UINT64_MAX, scroll = UINT64_MAX;
+        for (int r = 0; r < runs; r++) {
+            uint64_t c = run_clears(bpp, m), s = run_scrolls(bpp, m);
+            if (c < clear) clear = c;
+            if (s < scroll) scroll = s;
+        }
+        printf("%-10s %10.2f %12.2f\n", mode_names[m], (double)screen * CLEARS / (double)clear,
+               (double)scroll / SCROLLS / 1e3);
+    }
+    return 0;
+}
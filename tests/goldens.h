@@ -0,0 +1,55 @@
+    { // log
+        { 0x3acaf1d43393d7bfull, 0x5ccbfa1d0218019full, 0x08a316cdb68473f7ull, 0x402e4c2595ecfa83ull, }, // pixel
+        { 0x3bb18f2753977babull, 0x57f1fad6f37c55bfull, 0x74ce46014460e7dbull, 0x8db5c6b7f220c163ull, }, // opaque
+        { 0x3acaf1d43393d7bfull, 0x5ccbfa1d0218019full, 0x08a316cdb68473f7ull, 0x402e4c2595ecfa83ull, }, // shadow
+        { 0x3bb18f2753977babull, 0x57f1fad6f37c55bfull, 0x74ce46014460e7dbull, 0x8db5c6b7f220c163ull, }, // gcache
+        { 0x91f8f693df2e8e27ull, 0xa5aee95f7699cc0bull, 0x53366b3753ecea8full, 0xa77281864cfadf83ull, }, // scale
+        { 0x3bb18f2753977babull, 0x57f1fad6f37c55bfull, 0x74ce46014460e7dbull, 0x8db5c6b7f220c163ull, }, // grid
+        { 0x3bb18f2753977babull, 0x57f1fad6f37c55bfull, 0x74ce46014460e7dbull, 0x8db5c6b7f220c163ull, }, // grid_sb
+        { 0x3bb18f2753977babull, 0x57f1fad6f37c55bfull, 0x74ce46014460e7dbull, 0x8db5c6b7f220c163ull, }, // deferred
+        { 0xff51c95914218262ull, 0x9950c29025aa5442ull, 0xcd382e409136262aull, 0x7c9d05a6d504c8c2ull, }, // head
+    },
+    { // sgr
+        { 0xe61aed334e008a09ull, 0xad7d7833bfd63095ull, 0xb886b5de69796829ull, 0xbc70275dbed2859bull, }, // pixel
+        { 0x6c77273d3d068308ull, 0xec340c12ab2dd3cfull, 0x57e16592080213beull, 0xf5b028268878ee2eull, }, // opaque
+        { 0xe61aed334e008a09ull, 0xad7d7833bfd63095ull, 0xb886b5de69796829ull, 0xbc70275dbed2859bull, }, // shadow
+        { 0x6c77273d3d068308ull, 0xec340c12ab2dd3cfull, 0x57e16592080213beull, 0xf5b028268878ee2eull, }, // gcache
+        { 0x5bbb8c45e86637e3ull, 0x708e30d01e4b0963ull, 0xa76d794794be4e43ull, 0xbc8c9f8d3d9d5ae3ull, }, // scale
+        { 0x6c77273d3d068308ull, 0xec340c12ab2dd3cfull, 0x57e16592080213beull, 0xf5b028268878ee2eull, }, // grid
+        { 0x6c77273d3d068308ull, 0xec340c12ab2dd3cfull, 0x57e16592080213beull, 0xf5b028268878ee2eull, }, // grid_sb
+        { 0x6c77273d3d068308ull, 0xec340c12ab2dd3cfull, 0x57e16592080213beull, 0xf5b028268878ee2eull, }, // deferred
+        { 0xcf657da4d3c331e4ull, 0xe51b754f0e1c6199ull, 0x2e75bd334361c54cull, 0xc10ad49a59563673ull, }, // head
+    },
+    { // utf8
+        { 0x6a4c6b0467aa316aull, 0x7828c23c36833575ull, 0x02e0f62a8406ed88ull, 0xfe46a1c74627773eull, }, // pixel
+        { 0x6a4c6b0467aa316aull, 0x7828c23c36833575ull, 0x02e0f62a8406ed88ull, 0xfe46a1c74627773eull, }, // opaque
+        { 0x6a4c6b0467aa316aull, 0x7828c23c36833575ull, 0x02e0f62a8406ed88ull, 0xfe46a1c74627773eull, }, // shadow
+        { 0x6a4c6b0467aa316aull, 0x7828c23c36833575ull, 0x02e0f62a8406ed88ull, 0xfe46a1c74627773eull, }, // gcache
+        { 0xdb22f3650a62e437ull, 0xee7d6f9cb9db0b6bull, 0x1f8bf91cd822747full, 0xed7844f470b32503ull, }, // scale
+        { 0x6a4c6b0467aa316aull, 0x7828c23c36833575ull, 0x02e0f62a8406ed88ull, 0xfe46a1c74627773eull, }, // grid
+        { 0x6a4c6b0467aa316aull, 0x7828c23c36833575ull, 0x02e0f62a8406ed88ull, 0xfe46a1c74627773eull, }, // grid_sb
+        { 0x6a4c6b0467aa316aull, 0x7828c23c36833575ull, 0x02e0f62a8406ed88ull, 0xfe46a1c74627773eull, }, // deferred
+        { 0xa0c1fc25196d41e8ull, 0xb2a5551d484445f7ull, 0xc86d610bfac19d0aull, 0x72a9248ddfc40e15ull, }, // head
+    },
+    { // region
+        { 0xd50f66b792b5ac8dull, 0x7e569a2c805e31fbull, 0x034c9a92877cc829ull, 0xa417c399cfb4b07full, }, // pixel
+        { 0x88036fdc609be925ull, 0xbcc48de34dc4c6c3ull, 0x777a52f0a1b59e87ull, 0x36f1891cccea1905ull, }, // opaque
+        { 0xd50f66b792b5ac8dull, 0x7e569a2c805e31fbull, 0x034c9a92877cc829ull, 0xa417c399cfb4b07full, }, // shadow
+        { 0x88036fdc609be925ull, 0xbcc48de34dc4c6c3ull, 0x777a52f0a1b59e87ull, 0x36f1891cccea1905ull, }, // gcache
+        { 0x7e83258173b8a223ull, 0xf26ab44f044ecd63ull, 0xa9135a993631e453ull, 0xc690f297458fbb23ull, }, // scale
+        { 0x88036fdc609be925ull, 0xbcc48de34dc4c6c3ull, 0x777a52f0a1b59e87ull, 0x36f1891cccea1905ull, }, // grid
+        { 0x88036fdc609be925ull, 0xbcc48de34dc4c6c3ull, 0x777a52f0a1b59e87ull, 0x36f1891cccea1905ull, }, // grid_sb
+        { 0x88036fdc609be925ull, 0xbcc48de34dc4c6c3ull, 0x777a52f0a1b59e87ull, 0x36f1891cccea1905ull, }, // deferred
+        { 0x5f5960ac8e754078ull, 0x2b844529d4b0b02eull, 0x19b59c39ee7b4580ull, 0xcf02fa5035b0a30aull, }, // head
+    },
+    { // edit
+        { 0x6f1042f9a2469f4aull, 0xf4eeee911143b1d5ull, 0xfa1ccfa0197f6478ull, 0xb4db20788c11ec9eull, }, // pixel
+        { 0x0000a8d57b6b7c62ull, 0xe9a48620d018e7d1ull, 0x34badac75c24b920ull, 0x1e12b96db3a2f94eull, }, // opaque
+        { 0x6f1042f9a2469f4aull, 0xf4eeee911143b1d5ull, 0xfa1ccfa0197f6478ull, 0xb4db20788c11ec9eull, }, // shadow
+        { 0x0000a8d57b6b7c62ull, 0xe9a48620d018e7d1ull, 0x34badac75c24b920ull, 0x1e12b96db3a2f94eull, }, // gcache
+        { 0x287842249398c003ull, 0x9a9d881f43cf77e3ull, 0xe3e67b7ac76f9583ull, 0xae3bbef225a7f0e3ull, }, // scale
+        { 0x0000a8d57b6b7c62ull, 0xe9a48620d018e7d1ull, 0x34badac75c24b920ull, 0x1e12b96db3a2f94eull, }, // grid
+        { 0x0000a8d57b6b7c62ull, 0xe9a48620d018e7d1ull, 0x34badac75c24b920ull, 0x1e12b96db3a2f94eull, }, // grid_sb
+        { 0x0000a8d57b6b7c62ull, 0xe9a48620d018e7d1ull, 0x34badac75c24b920ull, 0x1e12b96db3a2f94eull, }, // deferred
+        { 0x8998ac61546d3868ull, 0x12660009e76816f7ull, 0x1c942138ef54c35aull, 0x1c35c3e99b236455ull, }, // head
+    },
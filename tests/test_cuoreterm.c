@@ -0,0 +1,951 @@
+// hosted tests for Cuoreterm.h. fixed scripts are run in every drawing mode at 8/16/24/32 bpp into malloc'd
+// framebuffers and the result is checked against golden checksums, whole and fed in odd sized pieces.
+// next to that the escape parser, scrollback, the queue, panes, arena init, font/format checks and every simd
+// or streaming kernel against the plain one.
+//
+//   ./test_cuoreterm          run everything, exit status is the number of failures
+//   ./test_cuoreterm --print  print the golden table for the current tree instead
+#define CUORETERM_IMPL
+#include "Cuoreterm.h"
+#include "kfont.h"
+
+#include <limits.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define W 328 // 41 columns
+#define H 150 // 10 rows and a part row
+#define PAD 12
+
+static int failed;
+
+#define CHECK(cond, ...) do { if (!(cond)) { failed++; printf("FAIL %s:%d: ", __FILE__, __LINE__); printf(__VA_ARGS__); printf("\n"); } } while (0)
+
+static uint64_t fnv(const uint8_t *p, size_t n) {
+    uint64_t h = 1469598103934665603ull;
+    for (size_t i = 0; i < n; i++) { h ^= p[i]; h *= 1099511628211ull; }
+    return h;
+}
+
+// ---- scripts ----
+
+enum { S_LOG, S_SGR, S_UTF8, S_REGION, S_EDIT, SCRIPTS };
+static const char *script_names[SCRIPTS] = { "log", "sgr", "utf8", "region", "edit" };
+
+static char script_buf[SCRIPTS][16384];
+static uint32_t script_len[SCRIPTS];
+
+#define ADD(s, ...) (script_len[s] += (uint32_t)snprintf(script_buf[s] + script_len[s], sizeof(script_buf[s]) - script_len[s], __VA_ARGS__))
+
+static void build_scripts(void) {
+    // a boot log: far more lines than rows, tabs, lines that wrap, \r overwrites and \b
+    for (int i = 0; i < 60; i++) {
+        ADD(S_LOG, "[%5d.%06d] dev%d:\tprobe ok", i / 7, i * 12345 % 1000000, i);
+        if (i % 9 == 0) ADD(S_LOG, " and a line long enough to wrap past the right edge of the screen");
+        if (i % 11 == 0) ADD(S_LOG, "\rOVER");
+        if (i % 13 == 0) ADD(S_LOG, "xx\b\b");
+        ADD(S_LOG, "\n");
+    }
+
+    // every way of picking a colour, with erases and opaque text over them
+    for (int i = 0; i < 16; i++) ADD(S_SGR, "\x1b[%dm\x1b[%dm c%02d ", 30 + i % 8 + (i >= 8 ? 60 : 0), 40 + (15 - i) % 8, i);
+    ADD(S_SGR, "\x1b[0m\n");
+    for (int i = 0; i < 256; i += 7) ADD(S_SGR, "\x1b[38;5;%dm\x1b[48;5;%dm#", i, 255 - i);
+    ADD(S_SGR, "\x1b[39;49m\n\x1b[38;2;255;128;0mrgb \x1b[48;2;0;64;128mon rgb\x1b[0m\n");
+    ADD(S_SGR, "\x1b[#00FF00mhex green \x1b[#12345mshort hex\x1b[0m\n");
+    ADD(S_SGR, "\x1b[44m\x1b[2K blue line\n\x1b[41mred to the end\x1b[0K\x1b[0m\n");
+    ADD(S_SGR, "\x1b[5;5H\x1b[42m\x1b[1Jerased above\x1b[0m\x1b[8;1H\x1b[103mbright bg\x1b[0m\n");
+
+    // utf-8: latin-1, box drawing, invalid and cut short sequences, surrogates and overlongs
+    ADD(S_UTF8, "caf\xc3\xa9 na\xc3\xafve \xc2\xb1\xc2\xb5\n");
+    ADD(S_UTF8, "\xe2\x94\x8c\xe2\x94\x80\xe2\x94\x80\xe2\x94\x90\n\xe2\x94\x82ok\xe2\x94\x82\n\xe2\x94\x94\xe2\x94\x80\xe2\x94\x80\xe2\x94\x98\n");
+    ADD(S_UTF8, "bad \xc3( \xe2\x82 \xed\xa0\x80 \xc0\xaf \xf4\x90\x80\x80 \xff end\n");
+    ADD(S_UTF8, "\xf0\x9f\x98\x80 emoji \xe2\x82\xac euro\n");
+    for (int i = 0; i < 30; i++) ADD(S_UTF8, "\xe2\x96\x88%d\xe2\x96\x91", i);
+
+    // a fixed header and footer around a scrolling region, then the whole screen again
+    ADD(S_REGION, "\x1b[1;1H\x1b[44mheader line\x1b[0m\x1b[10;1H\x1b[41mfooter line\x1b[0m");
+    ADD(S_REGION, "\x1b[2;9r\x1b[9;1H");
+    for (int i = 0; i < 25; i++) ADD(S_REGION, "\nregion %d \x1b[3%dmcolour\x1b[0m", i, i % 8);
+    ADD(S_REGION, "\x1b[r\x1b[10;1H\nwhole screen again\n");
+
+    // cursor moves, saves, erases and controls inside sequences
+    ADD(S_EDIT, "0123456789abcdefghijklmnopqrstuvwxyzABCDE\n");
+    ADD(S_EDIT, "\x1b[3;5Hat 3,5\x1b[2Aup\x1b[4Bdown\x1b[10Dleft\x1b[3Cright\x1b[20Gcol20\x1b[6dline6");
+    ADD(S_EDIT, "\x1b" "7\x1b[9;30Hsaved\x1b" "8restored");
+    ADD(S_EDIT, "\x1b[1;1H\x1b[5Cx\x1b[2\r0Cy\x1b[5\x18" "C\x1b[5\x1b[3Gz\x1b[\n2Bw");
+    ADD(S_EDIT, "\x1b[7;1Hkeep\x1b[7;3H\x1b[K\x1b[8;10Hmid\x1b[8;11H\x1b[1K\x1b[?25l\x1b[>c\x1b#8");
+    ADD(S_EDIT, "\x1b[999;999Hcorner\x1b[0;0Horigin\ttab\ttab\b\bbs");
+}
+
+// ---- modes ----
+
+enum { M_PIXEL, M_OPAQUE, M_SHADOW, M_GCACHE, M_SCALE, M_GRID, M_GRID_SB, M_DEFERRED, M_HEAD, MODES };
+static const char *mode_names[MODES] = { "pixel", "opaque", "shadow", "gcache", "scale", "grid", "grid_sb", "deferred", "head" };
+
+static const uint32_t bpps[] = { 8, 16, 24, 32 };
+#define BPPS 4
+
+// tasks run one after the other, the bands still split the present
+static void serial_tasks(void *ctx, cuoreterm_task_fn fn, void *arg, uint32_t count) {
+    (void)ctx;
+    for (uint32_t i = 0; i < count; i++) fn(arg, i);
+}
+
+// one thread per band, all joined before returning like a real scheduler hook
+struct thread_task {
+    pthread_t th;
+    cuoreterm_task_fn fn;
+    void *arg;
+    uint32_t index;
+};
+
+static void *thread_task_main(void *p) {
+    struct thread_task *tt = (struct thread_task *)p;
+    tt->fn(tt->arg, tt->index);
+    return 0;
+}
+
+#define MAX_TASKS 4
+
+static void thread_tasks(void *ctx, cuoreterm_task_fn fn, void *arg, uint32_t count) {
+    struct thread_task tt[MAX_TASKS];
+    (void)ctx;
+    for (uint32_t i = 0; i < count; i++) {
+        tt[i] = (struct thread_task){ .fn = fn, .arg = arg, .index = i };
+        pthread_create(&tt[i].th, 0, thread_task_main, &tt[i]);
+    }
+    for (uint32_t i = 0; i < count; i++) pthread_join(tt[i].th, 0);
+}
+
+// when set, every setup draws with this compiled font instead of the psf it was given
+static const struct cuoreterm_font *setup_font;
+
+struct setup {
+    struct terminal term;
+    uint8_t *fb, *shadow, *head, *bufs[6];
+    uint32_t pitch, head_pitch;
+};
+
+static void setup_mode(struct setup *s, uint32_t bpp, int mode) {
+    memset(s, 0, sizeof(*s));
+    s->pitch = W * ((bpp + 7) / 8) + PAD;
+    s->fb = calloc(s->pitch, H);
+
+    if (mode == M_SHADOW || mode == M_DEFERRED || mode == M_HEAD) {
+        s->shadow = calloc(s->pitch, H);
+        cuoreterm_init_shadow(&s->term, s->fb, W, H, s->pitch, bpp, s->shadow, iso10_f14_psf, 8, 14);
+    } else {
+        cuoreterm_init(&s->term, s->fb, W, H, s->pitch, bpp, iso10_f14_psf, 8, 14);
+    }
+
+    struct terminal *t = &s->term;
+    static uint16_t map[65536];
+    cuoreterm_set_font_map(t, map, 65536);
+    if (setup_font) cuoreterm_set_compiled_font(t, setup_font);
+
+    switch (mode) {
+        case M_OPAQUE:
+            cuoreterm_set_opaque(t, true);
+            break;
+        case M_GCACHE:
+            s->bufs[0] = malloc(cuoreterm_glyph_cache_slot_size(t) * 3);
+            cuoreterm_set_glyph_cache(t, s->bufs[0], cuoreterm_glyph_cache_slot_size(t) * 3);
+            break;
+        case M_SCALE:
+            s->bufs[0] = malloc(cuoreterm_scale_atlas_size(t, 2));
+            cuoreterm_set_scale(t, 2, s->bufs[0], cuoreterm_scale_atlas_size(t, 2));
+            break;
+        case M_GRID:
+        case M_GRID_SB:
+        case M_DEFERRED: {
+            uint32_t n = t->cols * t->rows;
+            s->bufs[0] = malloc(n * sizeof(struct cuoreterm_cell));
+            cuoreterm_set_grid(t, (struct cuoreterm_cell*)s->bufs[0], n);
+            if (mode == M_GRID_SB) {
+                s->bufs[1] = malloc(n * sizeof(struct cuoreterm_cell));
+                s->bufs[2] = malloc(4096);
+                cuoreterm_set_grid_diff(t, (struct cuoreterm_cell*)s->bufs[1], n);
+                cuoreterm_set_scrollback(t, s->bufs[2], 4096);
+                cuoreterm_set_task_hook(t, serial_tasks, 0, 3);
+            }
+            if (mode == M_DEFERRED) cuoreterm_set_deferred(t, true);
+            break;
+        }
+        case M_HEAD: {
+            // a bgr head at another depth, everything drawn is converted on present
+            struct cuoreterm_format f = { 32, 8, 0, 8, 8, 8, 16 };
+            if (bpp == 32) f = (struct cuoreterm_format){ 16, 5, 0, 6, 5, 5, 11 };
+            s->head_pitch = W * ((f.bpp + 7) / 8) + PAD;
+            s->head = calloc(s->head_pitch, H);
+            cuoreterm_add_head(t, s->head, W, H, s->head_pitch, &f);
+            break;
+        }
+    }
+}
+
+static uint64_t setup_sum(struct setup *s) {
+    uint64_t h = fnv(s->fb, (size_t)s->pitch * H);
+    if (s->head) h ^= fnv(s->head, (size_t)s->head_pitch * H) * 31;
+    return h;
+}
+
+static void setup_free(struct setup *s) {
+    free(s->fb);
+    free(s->shadow);
+    free(s->head);
+    for (int i = 0; i < 6; i++) free(s->bufs[i]);
+}
+
+// the script in one write, or in pieces of 1, 2, 3, 5, 8 ... bytes so every sequence gets split somewhere
+static uint64_t run_script(int script, uint32_t bpp, int mode, bool pieces) {
+    struct setup s;
+    setup_mode(&s, bpp, mode);
+
+    const char *p = script_buf[script];
+    uint32_t left = script_len[script];
+
+    if (!pieces) {
+        cuoreterm_write(&s.term, p, left);
+    } else {
+        uint32_t a = 1, b = 2;
+        while (left) {
+            uint32_t n = a < left ? a : left;
+            cuoreterm_write(&s.term, p, n);
+            p += n;
+            left -= n;
+            uint32_t c = a + b; a = b; b = c > 64 ? 1 : c;
+        }
+    }
+    cuoreterm_present(&s.term);
+
+    uint64_t h = setup_sum(&s);
+    setup_free(&s);
+    return h;
+}
+
+// goldens[script][mode][bpp], regenerate with --print when output changes on purpose
+static const uint64_t goldens[SCRIPTS][MODES][BPPS] = {
+#include "goldens.h"
+};
+
+static void test_goldens(bool print) {
+    for (int sc = 0; sc < SCRIPTS; sc++) {
+        if (print) printf("    { // %s\n", script_names[sc]);
+        for (int m = 0; m < MODES; m++) {
+            if (print) printf("        {");
+            for (int b = 0; b < BPPS; b++) {
+                uint64_t whole = run_script(sc, bpps[b], m, false);
+                if (print) { printf(" 0x%016llxull,", (unsigned long long)whole); continue; }
+
+                uint64_t split = run_script(sc, bpps[b], m, true);
+                CHECK(whole == goldens[sc][m][b], "%s %s %ubpp: %016llx, golden %016llx", script_names[sc], mode_names[m],
+                      bpps[b], (unsigned long long)whole, (unsigned long long)goldens[sc][m][b]);
+                CHECK(split == whole, "%s %s %ubpp: split writes differ", script_names[sc], mode_names[m], bpps[b]);
+            }
+            if (print) printf(" }, // %s\n", mode_names[m]);
+        }
+        if (print) printf("    },\n");
+    }
+
+    if (print) return;
+
+    // modes that only differ in how they get there have to draw the same picture
+    for (int sc = 0; sc < SCRIPTS; sc++) {
+        for (int b = 0; b < BPPS; b++) {
+            CHECK(goldens[sc][M_SHADOW][b] == goldens[sc][M_PIXEL][b], "%s %ubpp: shadow differs from pixel", script_names[sc], bpps[b]);
+            CHECK(goldens[sc][M_GRID_SB][b] == goldens[sc][M_GRID][b], "%s %ubpp: grid_sb differs from grid", script_names[sc], bpps[b]);
+            CHECK(goldens[sc][M_DEFERRED][b] == goldens[sc][M_GRID][b], "%s %ubpp: deferred differs from grid", script_names[sc], bpps[b]);
+            CHECK(goldens[sc][M_GCACHE][b] == goldens[sc][M_OPAQUE][b], "%s %ubpp: gcache differs from opaque", script_names[sc], bpps[b]);
+        }
+    }
+}
+
+// the grid drawn in bands on threads, with the diff or with the glyph cache, against the same bands run serially
+static uint64_t run_banded(int script, uint32_t bpp, bool gcache, cuoreterm_run_tasks_fn hook) {
+    struct setup s;
+    setup_mode(&s, bpp, M_GRID);
+    struct terminal *t = &s.term;
+    uint32_t n = t->cols * t->rows;
+
+    if (gcache) {
+        s.bufs[1] = malloc(cuoreterm_glyph_cache_slot_size(t) * 3);
+        cuoreterm_set_glyph_cache(t, s.bufs[1], cuoreterm_glyph_cache_slot_size(t) * 3);
+    } else {
+        s.bufs[1] = malloc(n * sizeof(struct cuoreterm_cell));
+        cuoreterm_set_grid_diff(t, (struct cuoreterm_cell*)s.bufs[1], n);
+    }
+    cuoreterm_set_task_hook(t, hook, 0, MAX_TASKS);
+
+    cuoreterm_write(&s.term, script_buf[script], script_len[script]);
+    cuoreterm_present(&s.term);
+
+    uint64_t h = setup_sum(&s);
+    setup_free(&s);
+    return h;
+}
+
+static void test_bands(void) {
+    for (int sc = 0; sc < SCRIPTS; sc++) {
+        for (int b = 0; b < BPPS; b++) {
+            for (int gcache = 0; gcache < 2; gcache++) {
+                uint64_t serial = run_banded(sc, bpps[b], gcache, serial_tasks);
+                uint64_t threads = run_banded(sc, bpps[b], gcache, thread_tasks);
+                CHECK(serial == goldens[sc][M_GRID][b], "%s %ubpp %s: serial bands differ from grid", script_names[sc], bpps[b],
+                      gcache ? "gcache" : "diff");
+                CHECK(threads == serial, "%s %ubpp %s: bands on threads differ from serial", script_names[sc], bpps[b],
+                      gcache ? "gcache" : "diff");
+            }
+        }
+    }
+}
+
+// ---- compiled fonts ----
+
+// the kfont compiled the way cuorefont does it: glyphs padded to 16 bytes, the map trimmed after the last
+// codepoint the font has and, with fmt, every glyph expanded in fg on bg
+static void compile_font(struct cuoreterm_font *cf, const struct cuoreterm_format *fmt, uint32_t fg, uint32_t bg) {
+    static uint8_t fb[8 * 8 * 4];
+    static uint16_t map[65536];
+    struct terminal t;
+    cuoreterm_init(&t, fb, 8, 8, 8 * 4, 32, iso10_f14_psf, 0, 0);
+    cuoreterm_set_font_map(&t, map, 65536);
+
+    uint32_t map_size = 65536;
+    while (map_size > 1 && map[map_size - 1] == t.font_missing) map_size--;
+
+    uint32_t w = t.font_glyph_w, h = t.font_glyph_h, stride = t.font_stride;
+    uint32_t gbytes = (stride * h + 15) & ~15u;
+    uint8_t *glyphs = calloc(t.glyph_count, gbytes);
+    for (uint32_t g = 0; g < t.glyph_count; g++) memcpy(glyphs + g * gbytes, t.font_bits + g * t.font_bytes, stride * h);
+
+    uint16_t *trimmed = malloc(map_size * sizeof(uint16_t));
+    memcpy(trimmed, map, map_size * sizeof(uint16_t));
+
+    *cf = (struct cuoreterm_font){
+        .glyph_w = w, .glyph_h = h, .stride = stride, .glyph_bytes = gbytes, .glyph_count = t.glyph_count,
+        .glyphs = glyphs, .map = trimmed, .map_size = map_size, .missing = t.font_missing,
+    };
+
+    if (fmt) {
+        cuoreterm_set_format(&t, fmt);
+        uint32_t row_bytes = w * t.pixel_bytes;
+        uint8_t *pixels = malloc((size_t)t.glyph_count * h * row_bytes);
+        for (uint32_t g = 0; g < t.glyph_count; g++)
+            for (uint32_t r = 0; r < h; r++)
+                t.ops->expand(pixels + ((size_t)g * h + r) * row_bytes, t.font_bits + g * t.font_bytes + r * stride,
+                              w, w, term_pack(fmt, fg), term_pack(fmt, bg));
+        cf->pixels = pixels;
+        cf->pixel_fmt = *fmt;
+        cf->pixel_fg = fg;
+        cf->pixel_bg = bg;
+    }
+}
+
+static void free_font(struct cuoreterm_font *cf) {
+    free((void *)cf->glyphs);
+    free((void *)cf->map);
+    free((void *)cf->pixels);
+}
+
+static void test_compiled_fonts(void) {
+    static const int modes[] = { M_PIXEL, M_OPAQUE, M_GCACHE, M_SCALE, M_GRID, M_DEFERRED };
+    static const char *kinds[] = { "no pixels", "pixels in the default colours", "pixels in other colours" };
+
+    for (int b = 0; b < BPPS; b++) {
+        // the format init guesses from bpp, what every mode here draws in
+        static uint8_t fb[4];
+        struct terminal t;
+        cuoreterm_init(&t, fb, 1, 1, 4, bpps[b], 0, 0, 0);
+        struct cuoreterm_format fmt = t.fmt;
+
+        for (int kind = 0; kind < 3; kind++) {
+            struct cuoreterm_font cf;
+            compile_font(&cf, kind ? &fmt : 0, kind == 1 ? 0xFFFFFF : 0xAAAAAA, kind == 1 ? 0x000000 : 0x0000AA);
+            setup_font = &cf;
+            for (int sc = 0; sc < SCRIPTS; sc++) {
+                for (uint32_t m = 0; m < sizeof(modes) / sizeof(modes[0]); m++) {
+                    uint64_t h = run_script(sc, bpps[b], modes[m], false);
+                    CHECK(h == goldens[sc][modes[m]][b], "compiled font with %s, %s %s %ubpp: differs from the psf",
+                          kinds[kind], script_names[sc], mode_names[modes[m]], bpps[b]);
+                }
+            }
+
+            // and the pixels are really what gets drawn, blank ones lose the text
+            if (kind == 1) {
+                memset((void *)cf.pixels, 0, (size_t)cf.glyph_count * cf.glyph_h * cf.glyph_w * ((fmt.bpp + 7) / 8));
+                CHECK(run_script(S_LOG, bpps[b], M_OPAQUE, false) != goldens[S_LOG][M_OPAQUE][b],
+                      "%ubpp: the compiled font's pixels are never used", bpps[b]);
+            }
+            setup_font = 0;
+            free_font(&cf);
+        }
+    }
+}
+
+// ---- escape parser ----
+
+static uint32_t cell_ch(struct terminal *t, uint32_t x, uint32_t y) {
+    return term_grid_row(t, y)[x].ch;
+}
+
+static void grid_term(struct terminal *t, uint8_t *fb, struct cuoreterm_cell *cells) {
+    cuoreterm_init(t, fb, W, H, W * 4, 32, iso10_f14_psf, 8, 14);
+    cuoreterm_set_grid(t, cells, 1024);
+}
+
+static void test_parser(void) {
+    static const struct {
+        const char *in;
+        uint32_t x, y;
+        int at_x, at_y;
+        uint32_t ch;
+    } cases[] = {
+        { "abc", 3, 0, 2, 0, 'c' },
+        { "\x1b[5;10H", 9, 4, -1, 0, 0 },
+        { "\x1b[5;10Hx\x1b[2Dy", 9, 4, 8, 4, 'y' },
+        { "\x1b[3;3H\x1b" "7\x1b[9;9H\x1b" "8", 2, 2, -1, 0, 0 },
+        { "ab\x1b[2\r0Cx", 21, 0, 20, 0, 'x' },         // cr inside a csi runs and the csi goes on
+        { "\x1b[5\x18" "C", 1, 0, 0, 0, 'C' },          // can cancels it
+        { "\x1b[5\x1b[3Gy", 3, 0, 2, 0, 'y' },          // esc starts over
+        { "\x1b[\n2Bz", 1, 3, 0, 3, 'z' },              // lf inside
+        { "\x1b[2\x7f" "Cx", 3, 0, 2, 0, 'x' },        // del inside is dropped
+        { "a\x7f", 2, 0, 1, 0, 0x7F },                 // and drawn outside one
+        { "a\tb", 9, 0, 8, 0, 'b' },
+        { "ab\b", 1, 0, 1, 0, 0 },
+        { "abcdef\r\x1b[K", 0, 0, 3, 0, 0 },
+        { "\xe2\x94\x80", 1, 0, 0, 0, 0x2500 },
+        { "\xc3(", 2, 0, 0, 0, 0xFFFD },
+        { "\xed\xa0\x80", 1, 0, 0, 0, 0xFFFD },       // surrogate
+        { "\x1b[999;999H", 40, 9, -1, 0, 0 },
+        { "\x1b[?25lq", 1, 0, 0, 0, 'q' },             // private sequences are skipped whole
+        { "\x1b[2;4r\x1b[4;1H\n\n", 0, 3, -1, 0, 0 },  // newlines stop at the region's bottom
+    };
+    static uint8_t fb[W * 4 * H];
+    static struct cuoreterm_cell cells[1024];
+
+    for (uint32_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        struct terminal t;
+        grid_term(&t, fb, cells);
+
+        // byte by byte too, sequences may be split anywhere
+        for (int pass = 0; pass < 2; pass++) {
+            cuoreterm_write(&t, "\x1b[r", 3);
+            cuoreterm_clear(&t);
+            uint32_t n = (uint32_t)strlen(cases[i].in);
+            if (pass) for (uint32_t k = 0; k < n; k++) cuoreterm_write(&t, cases[i].in + k, 1);
+            else cuoreterm_write(&t, cases[i].in, n);
+
+            CHECK(t.cursor_x == cases[i].x && t.cursor_y == cases[i].y, "parser case %u pass %d: cursor %u,%u want %u,%u",
+                  i, pass, t.cursor_x, t.cursor_y, cases[i].x, cases[i].y);
+            if (cases[i].at_x >= 0)
+                CHECK(cell_ch(&t, (uint32_t)cases[i].at_x, (uint32_t)cases[i].at_y) == cases[i].ch, "parser case %u pass %d: cell %x want %x",
+                      i, pass, cell_ch(&t, (uint32_t)cases[i].at_x, (uint32_t)cases[i].at_y), cases[i].ch);
+        }
+    }
+
+    // the colours a cell is stored with
+    struct terminal t;
+    grid_term(&t, fb, cells);
+    const char *colours = "\x1b[#00FF00ma\x1b[38;5;196mb\x1b[48;2;1;2;3mc\x1b[0m\x1b[94;45md";
+    cuoreterm_write(&t, colours, (uint32_t)strlen(colours));
+    CHECK(term_grid_row(&t, 0)[0].fg == 0x00FF00, "hex fg %x", term_grid_row(&t, 0)[0].fg);
+    CHECK(term_grid_row(&t, 0)[1].fg == 0xFF0000, "256 fg %x", term_grid_row(&t, 0)[1].fg);
+    CHECK(term_grid_row(&t, 0)[2].bg == 0x010203, "rgb bg %x", term_grid_row(&t, 0)[2].bg);
+    CHECK(term_grid_row(&t, 0)[3].fg == 0x5555FF && term_grid_row(&t, 0)[3].bg == 0xAA00AA, "sgr 94;45 %x on %x",
+          term_grid_row(&t, 0)[3].fg, term_grid_row(&t, 0)[3].bg);
+}
+
+// ---- scrollback ----
+
+static void write_lines(struct terminal *t, int from, int to, bool last_newline) {
+    char b[64];
+    for (int i = from; i < to; i++) {
+        int n = snprintf(b, sizeof(b), "\x1b[3%dmline %d%s\x1b[0m%s", i % 8, i, i % 3 ? " \xe2\x94\x80 wide" : "",
+                         i + 1 < to || last_newline ? "\n" : "");
+        cuoreterm_write(t, b, (uint32_t)n);
+    }
+}
+
+static void test_scrollback(void) {
+    static uint8_t fb[W * 4 * H], fb2[W * 4 * H], sb[1 << 14];
+    static struct cuoreterm_cell cells[1024], cells2[1024];
+    struct terminal t, u;
+
+    grid_term(&t, fb, cells);
+    cuoreterm_set_scrollback(&t, sb, sizeof(sb));
+    write_lines(&t, 0, 50, true);
+
+    // 50 lines and the cursor row, 10 rows on screen
+    CHECK(cuoreterm_scrollback_lines(&t) == 41, "scrollback lines %u", cuoreterm_scrollback_lines(&t));
+    CHECK(cuoreterm_scrollback_bytes(&t) > 0 && cuoreterm_scrollback_bytes(&t) <= sizeof(sb), "scrollback bytes %u",
+          cuoreterm_scrollback_bytes(&t));
+
+    // k lines back is what the screen showed when line 50 - k was the last one written
+    for (uint32_t k = 1; k <= 41; k += 8) {
+        cuoreterm_set_view(&t, k);
+        grid_term(&u, fb2, cells2);
+        write_lines(&u, 0, 51 - (int)k, false);
+        CHECK(!memcmp(fb, fb2, sizeof(fb)), "scrollback view %u differs", k);
+    }
+
+    cuoreterm_set_view(&t, 1000);
+    CHECK(t.sb_view == 41, "view clamped to %u", t.sb_view);
+
+    // back to live on the next write
+    cuoreterm_set_view(&t, 0);
+    grid_term(&u, fb2, cells2);
+    write_lines(&u, 0, 50, true);
+    CHECK(!memcmp(fb, fb2, sizeof(fb)), "live view differs");
+
+    // a small ring keeps only the newest lines
+    static uint8_t small[512];
+    grid_term(&t, fb, cells);
+    cuoreterm_set_scrollback(&t, small, sizeof(small));
+    write_lines(&t, 0, 200, true);
+    CHECK(cuoreterm_scrollback_lines(&t) > 0 && cuoreterm_scrollback_lines(&t) < 191 && cuoreterm_scrollback_bytes(&t) <= sizeof(small),
+          "small ring %u lines %u bytes", cuoreterm_scrollback_lines(&t), cuoreterm_scrollback_bytes(&t));
+}
+
+// ---- printf ----
+
+#define PF_COLS 120
+
+// what cuoreterm_printf left in the first row, has to be what snprintf makes of the same
+static void printf_check(struct terminal *t, const char *want, int line) {
+    uint32_t n = (uint32_t)strlen(want), bad = n > PF_COLS - 1 || t->cursor_x != n;
+    for (uint32_t x = 0; !bad && x < n; x++) bad = term_grid_row(t, 0)[x].ch != (uint8_t)want[x];
+
+    char got[PF_COLS + 1];
+    for (uint32_t x = 0; x < PF_COLS; x++) got[x] = (char)(term_grid_row(t, 0)[x].ch ? term_grid_row(t, 0)[x].ch : '.');
+    got[PF_COLS] = 0;
+    CHECK(!bad, "printf at line %d: \"%s\" want \"%s\"", line, got, want);
+}
+
+#define PF(...) do { \
+    char want[PF_COLS]; \
+    snprintf(want, sizeof(want), __VA_ARGS__); \
+    cuoreterm_clear(&t); \
+    cuoreterm_printf(&t, __VA_ARGS__); \
+    printf_check(&t, want, __LINE__); \
+} while (0)
+
+static void test_printf(void) {
+    static uint8_t fb[PF_COLS * 8 * 4 * 14];
+    static struct cuoreterm_cell cells[PF_COLS];
+    struct terminal t;
+    cuoreterm_init(&t, fb, PF_COLS * 8, 14, PF_COLS * 8 * 4, 32, iso10_f14_psf, 8, 14);
+    cuoreterm_set_grid(&t, cells, PF_COLS);
+
+    PF("%d %d %d %i", 0, 42, -42, INT_MIN);
+    PF("%u %u %x %X %o", 0u, UINT_MAX, 0xdeadbeefu, 0xdeadbeefu, 0777u);
+    PF("[%5d] [%-5d] [%05d] [%+d] [% d] [%+d]", 42, 42, -42, 42, 42, -7);
+    PF("[%#x] [%#X] [%#o] [%08x] [%-8x] [%#010x]", 255u, 255u, 8u, 0xabcu, 0xabcu, 0xabcu);
+    PF("[%.3d] [%8.3d] [%-8.3d] [%.0d] [%.0x]", 7, -7, 7, 0, 0u);
+    PF("%lld %lld %llu %llx %llX", LLONG_MIN, LLONG_MAX, ULLONG_MAX, 0x123456789abcdefull, ULLONG_MAX);
+    PF("%ld %lu %lx %zu %zx", -1234567890123l, 1234567890123ul, 0xfeedfacecafeul, (size_t)12345, (size_t)0xbeef);
+    PF("%hd %hu %hhd %hhu %hx", (short)-300, (unsigned short)65535, (signed char)-100, (unsigned char)200, (unsigned short)0xabcd);
+    PF("%p %p", (void *)0x1000, (void *)0xffff800000001234ull);
+    PF("[%s] [%10s] [%-10s] [%.3s] [%.*s]", "str", "right", "left", "truncated", 2, "cut");
+    PF("[%c] [%3c] [%-3c] [%c]", 'a', 'b', 'c', '%');
+    PF("[%*d] [%-*d] [%.*d] [%*.*d]", 6, 1, 6, 2, 4, 3, 8, 5, -4);
+    PF("100%% %%d %s", "done");
+}
+
+// ---- queue ----
+
+#define Q_THREADS 6
+#define Q_RECORDS 2000
+#define Q_COLS 16
+
+static struct cuoreterm_queue queue;
+static volatile int producers_left;
+
+static void *producer(void *arg) {
+    uint32_t id = (uint32_t)(uintptr_t)arg;
+    char b[Q_COLS + 1];
+
+    for (uint32_t i = 0; i < Q_RECORDS; i++) {
+        snprintf(b, sizeof(b), "p%u %010u\n", id, i); // exactly one row of Q_COLS - 2 cells and a newline
+        cuoreterm_queue_write(&queue, b, 14);
+    }
+    __atomic_fetch_sub(&producers_left, 1, __ATOMIC_RELEASE);
+    return 0;
+}
+
+static void test_queue(void) {
+    static uint8_t ring[1 << 16];
+    // a cell of 8x1 so a framebuffer with a row per record stays small
+    uint32_t rows = Q_THREADS * Q_RECORDS + 1;
+    uint8_t *fb = calloc(Q_COLS * 8, rows);
+    struct cuoreterm_cell *cells = malloc(sizeof(*cells) * Q_COLS * rows);
+    struct terminal t;
+
+    cuoreterm_init(&t, fb, Q_COLS * 8, rows, Q_COLS * 8, 8, iso10_f14_psf, 8, 1);
+    cuoreterm_set_grid(&t, cells, Q_COLS * rows);
+    cuoreterm_set_deferred(&t, true);
+    cuoreterm_queue_init(&queue, ring, sizeof(ring));
+
+    pthread_t th[Q_THREADS];
+    producers_left = Q_THREADS;
+    for (uint32_t i = 0; i < Q_THREADS; i++) pthread_create(&th[i], 0, producer, (void*)(uintptr_t)i);
+
+    uint32_t drained = 0;
+    for (;;) {
+        // once every producer is done a drain that finds nothing means the queue is empty for good
+        bool done = __atomic_load_n(&producers_left, __ATOMIC_ACQUIRE) == 0;
+        uint32_t n = cuoreterm_queue_drain(&queue, &t);
+        drained += n;
+        if (done && !n) break;
+    }
+    for (uint32_t i = 0; i < Q_THREADS; i++) pthread_join(th[i], 0);
+
+    CHECK(drained + queue.dropped == Q_THREADS * Q_RECORDS, "queue drained %u dropped %u", drained, queue.dropped);
+
+    // every row is one whole record and each producer's records come in order
+    uint32_t next[Q_THREADS] = { 0 };
+    uint32_t bad = 0;
+    for (uint32_t y = 0; y < drained && y < t.rows; y++) {
+        const struct cuoreterm_cell *row = term_grid_row(&t, y);
+        char b[Q_COLS];
+        for (uint32_t x = 0; x < 13; x++) b[x] = (char)row[x].ch;
+        b[13] = 0;
+
+        uint32_t id, seq;
+        if (sscanf(b, "p%u %u", &id, &seq) != 2 || id >= Q_THREADS || seq < next[id] || row[13].ch) { bad++; continue; }
+        next[id] = seq + 1;
+    }
+    CHECK(!bad, "queue: %u rows torn or out of order", bad);
+    CHECK(queue.dropped || drained == Q_THREADS * Q_RECORDS, "queue lost records without counting them");
+
+    // a record of half the ring fits an empty one at every offset, anything bigger never does
+    static uint8_t small[100];
+    struct cuoreterm_queue sq;
+    cuoreterm_queue_init(&sq, small, sizeof(small));
+    CHECK(sq.size == 64, "queue of 100 bytes rounded to %u", sq.size);
+    for (uint32_t off = 0; off < 64; off += 4) {
+        cuoreterm_queue_write(&sq, "0123456789abcdef0123456789ab", 28);
+        cuoreterm_queue_write(&sq, "0123456789abcdef0123456789abcdef", 32);
+        CHECK(cuoreterm_queue_drain(&sq, &t) == 1 && sq.dropped == 1 + off / 4,
+              "queue at offset %u: %u dropped", off, sq.dropped);
+        // an empty record moves the next one along by 4 bytes
+        cuoreterm_queue_write(&sq, "", 0);
+        cuoreterm_queue_drain(&sq, &t);
+    }
+    cuoreterm_queue_init(&sq, small, 3);
+    cuoreterm_queue_write(&sq, "x", 1);
+    CHECK(sq.size == 0 && sq.dropped == 1 && !cuoreterm_queue_drain(&sq, &t), "queue of 3 bytes took a write");
+
+    free(fb);
+    free(cells);
+}
+
+// ---- panes ----
+
+static void test_panes(void) {
+    for (int shadowed = 0; shadowed < 2; shadowed++) {
+        uint32_t pitch = W * 4 + PAD;
+        uint8_t *fb = malloc((size_t)pitch * H), *shadow = calloc(pitch, H);
+        memset(fb, 0xA5, (size_t)pitch * H);
+        memset(shadow, 0xA5, (size_t)pitch * H);
+
+        struct terminal status, log;
+        if (shadowed) {
+            cuoreterm_init_shadow(&status, fb, W, H, pitch, 32, shadow, iso10_f14_psf, 8, 14);
+            cuoreterm_init_shadow(&log, fb, W, H, pitch, 32, shadow, iso10_f14_psf, 8, 14);
+        } else {
+            cuoreterm_init(&status, fb, W, H, pitch, 32, iso10_f14_psf, 8, 14);
+            cuoreterm_init(&log, fb, W, H, pitch, 32, iso10_f14_psf, 8, 14);
+        }
+        cuoreterm_set_pane(&status, 0, 0, W, 14);
+        cuoreterm_set_pane(&log, 16, 20, 200, 100);
+        CHECK(log.cols == 25 && log.rows == 7, "pane is %ux%u cells", log.cols, log.rows);
+
+        cuoreterm_clear(&status);
+        cuoreterm_clear(&log);
+        for (int i = 0; i < 40; i++) {
+            cuoreterm_printf(&status, "\r\x1b[42mstatus %d\x1b[0m", i);
+            cuoreterm_printf(&log, "log line %d with enough text to wrap once\n", i);
+        }
+        cuoreterm_write(&log, "\x1b[999;999Hx\x1b[2J", 11);
+
+        // nothing outside the two rects was touched
+        uint32_t outside = 0;
+        for (uint32_t y = 0; y < H; y++) {
+            for (uint32_t x = 0; x < pitch; x++) {
+                bool in_status = y < 14; // full width, so its rows are cleared pitch and all
+                bool in_log = y >= 20 && y < 120 && x >= 16 * 4 && x < (16 + 200) * 4;
+                if (!in_status && !in_log && fb[y * pitch + x] != 0xA5) outside++;
+            }
+        }
+        CHECK(!outside, "panes %s: %u bytes outside their rects changed", shadowed ? "with shadow" : "", outside);
+
+        // the status pane still shows its last line
+        uint32_t lit = 0;
+        for (uint32_t x = 0; x < W * 4; x++) lit += fb[5 * pitch + x] != 0;
+        CHECK(lit > 0, "status pane lost its text");
+
+        free(fb);
+        free(shadow);
+    }
+}
+
+// ---- arena ----
+
+static void test_arena(void) {
+    uint32_t pitch = W * 4;
+    struct cuoreterm_format fmt = { 32, 8, 16, 8, 8, 8, 0 };
+    struct cuoreterm_config cfg = {
+        .fb_width = W, .fb_height = H, .fb_pitch = pitch, .fb_bpp = 32, .fmt = &fmt,
+        .font = iso10_f14_psf, .font_size = sizeof(iso10_f14_psf), .font_w = 8, .font_h = 14,
+        .scale = 2, .font_map = 65536, .shadow = true, .grid = true, .grid_diff = true,
+        .glyph_cache = 2, .scrollback = 4096,
+    };
+
+    uint8_t *fb = calloc(pitch, H), *fb2 = calloc(pitch, H);
+    cfg.fb_addr = fb;
+    uint64_t need = cuoreterm_required_memory(&cfg);
+    CHECK(need > (uint64_t)pitch * H, "arena needs only %llu", (unsigned long long)need);
+
+    // a misaligned arena costs up to 63 bytes more and every buffer lands inside it
+    uint8_t *arena = (uint8_t*)malloc(need + 64 + 1) + 1;
+    struct terminal t;
+    CHECK(!cuoreterm_init_arena(&t, &cfg, arena, need), "arena init took a short misaligned arena");
+    CHECK(cuoreterm_init_arena(&t, &cfg, arena, need + 63), "arena init failed");
+
+    uint8_t *lo = arena, *hi = arena + need + 63;
+#define IN_ARENA(p) ((uint8_t*)(p) >= lo && (uint8_t*)(p) < hi && !((uintptr_t)(p) & 63))
+    CHECK(IN_ARENA(t.cells) && IN_ARENA(t.prev) && IN_ARENA(t.gcache) && IN_ARENA(t.atlas) && IN_ARENA(t.sb) &&
+          IN_ARENA(t.font_map_buf) && IN_ARENA(t.screen_shadow), "arena buffers outside the arena or misaligned");
+#undef IN_ARENA
+    CHECK(t.scale == 2 && t.prev && t.sb && t.gcache_slots == 2, "arena setup scale %u prev %d sb %d slots %u",
+          t.scale, t.prev != 0, t.sb != 0, t.gcache_slots);
+
+    // the same terminal set up by hand draws the same
+    struct terminal u;
+    uint8_t *shadow = calloc(pitch, H), *atlas, *gcache, *sb;
+    static uint16_t map[65536];
+    cuoreterm_init_shadow(&u, fb2, W, H, pitch, 32, shadow, iso10_f14_psf, 8, 14);
+    cuoreterm_set_format(&u, &fmt);
+    atlas = malloc(cuoreterm_scale_atlas_size(&u, 2));
+    cuoreterm_set_scale(&u, 2, atlas, cuoreterm_scale_atlas_size(&u, 2));
+    cuoreterm_set_font_map(&u, map, 65536);
+    struct cuoreterm_cell *cells = malloc(sizeof(*cells) * u.cols * u.rows), *prev = malloc(sizeof(*prev) * u.cols * u.rows);
+    cuoreterm_set_grid(&u, cells, u.cols * u.rows);
+    cuoreterm_set_grid_diff(&u, prev, u.cols * u.rows);
+    sb = malloc(4096);
+    cuoreterm_set_scrollback(&u, sb, 4096);
+    gcache = malloc(cuoreterm_glyph_cache_slot_size(&u) * 2);
+    cuoreterm_set_glyph_cache(&u, gcache, cuoreterm_glyph_cache_slot_size(&u) * 2);
+
+    for (int i = 0; i < SCRIPTS; i++) {
+        cuoreterm_write(&t, script_buf[i], script_len[i]);
+        cuoreterm_write(&u, script_buf[i], script_len[i]);
+    }
+    CHECK(!memcmp(fb, fb2, (size_t)pitch * H), "arena terminal draws differently");
+
+    // a format that can't be drawn with is turned down
+    struct cuoreterm_format zero = { 32, 0, 16, 8, 8, 8, 0 };
+    cfg.fmt = &zero;
+    CHECK(cuoreterm_required_memory(&cfg) == 0, "bad format still sized");
+    CHECK(!cuoreterm_init_arena(&t, &cfg, arena, need + 63), "bad format still set up");
+
+    free(arena - 1);
+    free(fb); free(fb2); free(shadow); free(atlas); free(cells); free(prev); free(sb); free(gcache);
+}
+
+// ---- fonts and formats ----
+
+static void test_fonts(void) {
+    static uint8_t fb[W * 4 * H];
+    struct terminal t;
+    cuoreterm_init(&t, fb, W, H, W * 4, 32, iso10_f14_psf, 8, 14);
+
+    // every cut short copy is turned down and leaves the font alone, the whole one loads
+    uint32_t size = sizeof(iso10_f14_psf), took = 0;
+    for (uint32_t n = 1; n < size; n++) {
+        uint8_t *copy = malloc(n);
+        memcpy(copy, iso10_f14_psf, n);
+        if (cuoreterm_set_font_sized(&t, copy, n, 0, 0)) took++;
+        free(copy);
+    }
+    CHECK(!took, "%u truncated fonts accepted", took);
+    CHECK(t.font_data == iso10_f14_psf, "a rejected font replaced the old one");
+    CHECK(cuoreterm_set_font_sized(&t, iso10_f14_psf, size, 0, 0), "whole font rejected");
+
+    // a psf2 header claiming more glyphs than there are
+    uint8_t psf2[32 + 16] = { 0x72, 0xb5, 0x4a, 0x86, 0, 0, 0, 0, 32, 0, 0, 0, 0, 0, 0, 0, 2, 0, 0, 0, 8, 0, 0, 0, 8, 0, 0, 0, 8 };
+    CHECK(cuoreterm_set_font_sized(&t, psf2, sizeof(psf2), 0, 0), "two glyph psf2 rejected");
+    psf2[16] = 3;
+    CHECK(!cuoreterm_set_font_sized(&t, psf2, sizeof(psf2), 0, 0), "psf2 with glyphs past the end accepted");
+    psf2[16] = 2;
+    psf2[20] = 4; // glyphs smaller than their rows
+    CHECK(!cuoreterm_set_font_sized(&t, psf2, sizeof(psf2), 0, 0), "psf2 with short glyphs accepted");
+
+    // pixel formats
+    struct cuoreterm_format ok = { 32, 8, 0, 8, 8, 8, 16 }, deep = { 32, 10, 20, 10, 10, 10, 0 };
+    struct cuoreterm_format none = { 32, 8, 16, 0, 8, 8, 0 }, wide = { 32, 17, 0, 8, 17, 7, 25 }, over = { 16, 8, 16, 8, 8, 8, 0 };
+    CHECK(cuoreterm_set_format(&t, &ok) && cuoreterm_set_format(&t, &deep), "good formats rejected");
+    CHECK(!cuoreterm_set_format(&t, &none) && !cuoreterm_set_format(&t, &wide) && !cuoreterm_set_format(&t, &over),
+          "bad formats accepted");
+    CHECK(t.fmt.r_size == 10, "a rejected format changed the terminal");
+    CHECK(!cuoreterm_add_head(&t, fb, W, H, W * 4, &ok), "head without a shadow accepted");
+
+    // a NULL font at init over stale bytes: no cells and nothing drawn until a font is set
+    static struct cuoreterm_cell cells[(W / 8) * (H / 14)];
+    memset(&t, 0xA5, sizeof(t));
+    memset(fb, 0x00, sizeof(fb));
+    cuoreterm_init(&t, fb, W, H, W * 4, 32, 0, 0, 0);
+    cuoreterm_set_grid(&t, cells, sizeof(cells) / sizeof(cells[0]));
+    cuoreterm_set_pane(&t, 8, 14, W - 8, H - 14);
+    cuoreterm_set_scale(&t, 1, 0, 0);
+    cuoreterm_write(&t, "no font\n", 8);
+    cuoreterm_printf(&t, "%d", 42);
+    cuoreterm_draw_char(&t, 'x', 0xFFFFFF);
+    cuoreterm_present(&t);
+    uint32_t lit = 0;
+    for (uint32_t i = 0; i < sizeof(fb); i++) lit += fb[i] != 0;
+    CHECK(!t.cols && !t.rows && !lit, "no font: %ux%u cells, %u bytes drawn", t.cols, t.rows, lit);
+
+    struct cuoreterm_font cf;
+    compile_font(&cf, 0, 0, 0);
+    cuoreterm_set_compiled_font(&t, &cf);
+    cuoreterm_write(&t, "x", 1);
+    for (uint32_t i = 0; i < sizeof(fb); i++) lit += fb[i] != 0;
+    CHECK(t.cols == (W - 8) / 8 && t.rows == (H - 14) / 14 && lit, "font set after a NULL one: %ux%u cells, %u bytes drawn",
+          t.cols, t.rows, lit);
+    free_font(&cf);
+}
+
+// ---- stats ----
+
+#ifdef CUORETERM_STATS
+static void test_stats(void) {
+    static uint8_t fb[W * 4 * H];
+    struct terminal t;
+    struct cuoreterm_stats st;
+    cuoreterm_init(&t, fb, W, H, W * 4, 32, iso10_f14_psf, 8, 14);
+
+    // 11 glyphs and 2 escapes on the top row
+    cuoreterm_write(&t, "hello\x1b[31m world\x1b[0m", 20);
+    cuoreterm_get_stats(&t, &st);
+    CHECK(st.glyphs == 11 && st.escapes == 2 && st.scrolls == 0, "stats after one line: %llu glyphs %llu escapes %llu scrolls",
+          (unsigned long long)st.glyphs, (unsigned long long)st.escapes, (unsigned long long)st.scrolls);
+    CHECK(st.fb_written > 0 && st.cycles_write > 0 && st.cycles_glyph > 0, "stats wrote nothing or took no time");
+
+    // a line a write, the last 3 of 12 scroll one row each
+    cuoreterm_reset_stats(&t);
+    for (int i = 0; i < 12; i++) cuoreterm_write(&t, "x\n", 2);
+    cuoreterm_get_stats(&t, &st);
+    CHECK(st.glyphs == 12 && st.scrolls == 3 && st.scroll_rows == 3 && st.escapes == 0,
+          "stats after 12 lines: %llu glyphs %llu scrolls %llu rows", (unsigned long long)st.glyphs,
+          (unsigned long long)st.scrolls, (unsigned long long)st.scroll_rows);
+
+    // 5 lines in one write at the bottom are one scroll of 5 rows
+    cuoreterm_reset_stats(&t);
+    cuoreterm_write(&t, "a\nb\nc\nd\ne\n", 10);
+    cuoreterm_get_stats(&t, &st);
+    CHECK(st.glyphs == 5 && st.scrolls == 1 && st.scroll_rows == 5, "stats after one 5 line write: %llu glyphs %llu scrolls %llu rows",
+          (unsigned long long)st.glyphs, (unsigned long long)st.scrolls, (unsigned long long)st.scroll_rows);
+
+    cuoreterm_reset_stats(&t);
+    cuoreterm_get_stats(&t, &st);
+    CHECK(!st.glyphs && !st.scrolls && !st.escapes && !st.fb_written && !st.cycles_write, "stats not reset");
+}
+#endif
+
+// ---- kernels ----
+
+// every glyph, fill and copy kernel this cpu supports against the plain one, false if any byte differs.
+// the simd and streaming kernels are only reached through the tables, so they are tested there
+static bool check_kernels(void) {
+    uint32_t feat = term_cpu_features();
+    uint8_t glyph[16];
+    uint8_t want[16 * 32], got[16 * 32], src[16 * 32];
+
+    for (uint32_t i = 0; i < TERM_GLYPH_KERNELS; i++) {
+        uint8_t bytes = term_glyph_kernels[i].bytes;
+        if (term_glyph_kernels[i].needs & ~feat) continue;
+
+        // draw every bit pattern over junk with both and compare, transparent then opaque
+        const struct cuoreterm_pixel_ops *ref = term_pick_ops(bytes);
+
+        for (uint32_t base = 0; base < 512; base += 16) {
+            for (uint32_t j = 0; j < 16; j++) glyph[j] = (uint8_t)(base + j);
+            for (uint32_t j = 0; j < sizeof(want); j++) want[j] = got[j] = (uint8_t)(j * 7 + base);
+
+            if (base < 256) {
+                ref->glyph(want, 32, glyph, 16, 0x89ABCDEF);
+                term_glyph_kernels[i].fn(got, 32, glyph, 16, 0x89ABCDEF);
+            } else {
+                ref->opaque(want, 32, glyph, 16, 0x89ABCDEF, 0x13579BDF);
+                term_glyph_kernels[i].opaque(got, 32, glyph, 16, 0x89ABCDEF, 0x13579BDF);
+            }
+
+            for (uint32_t j = 0; j < sizeof(want); j++)
+                if (want[j] != got[j]) return false;
+        }
+    }
+
+    // fills and copies at every start alignment over lengths on both sides of each unrolled loop
+    for (uint32_t i = 0; i < TERM_MEM_KERNELS; i++) {
+        if (term_mem_kernels[i].needs & ~feat) continue;
+
+        for (uint32_t off = 0; off < 16; off++) {
+            for (uint32_t n = 0; n + off <= sizeof(want); n += (n < 80 ? 1 : 37)) {
+                for (uint32_t j = 0; j < sizeof(want); j++) {
+                    want[j] = got[j] = (uint8_t)(j * 13 + off);
+                    src[j] = (uint8_t)(j * 5 + n);
+                }
+
+                if (n & 1) {
+                    term_fill_plain(want + off, (uint8_t)n, n);
+                    term_mem_kernels[i].fill(got + off, (uint8_t)n, n);
+                } else {
+                    term_copy_plain(want + off, src + (n & 15), n - (n & 15));
+                    term_mem_kernels[i].copy(got + off, src + (n & 15), n - (n & 15));
+                }
+                term_store_fence();
+
+                for (uint32_t j = 0; j < sizeof(want); j++)
+                    if (want[j] != got[j]) return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+static void test_kernels(void) {
+    CHECK(check_kernels(), "a simd or streaming kernel differs from the plain one");
+}
+
+int main(int argc, char **argv) {
+    bool print = argc > 1 && !strcmp(argv[1], "--print");
+
+    build_scripts();
+    if (print) {
+        test_goldens(true);
+        return 0;
+    }
+
+    test_kernels();
+    test_goldens(false);
+    test_bands();
+    test_compiled_fonts();
+    test_parser();
+    test_scrollback();
+    test_printf();
+    test_queue();
+    test_panes();
+    test_arena();
+    test_fonts();
+#ifdef CUORETERM_STATS
+    test_stats();
+#endif
+
+    printf("%d failed\n", failed);
+    return failed != 0;
+}
@@ -0,0 +1,189 @@
+// cuorefont: compiles a psf1/psf2 font into a header of const data for cuoreterm_set_compiled_font, so the
+// console has nothing to parse or build at boot. it is a host program built on the terminal itself,
+// the map and pixels it writes are exactly what cuoreterm_set_font and the glyph cache would make
+//
+//   cc -O2 -o cuorefont tools/cuorefont.c
+//   ./cuorefont [-n name] [-a align] [-p bpp:rs:rsh:gs:gsh:bs:bsh[:fg:bg]] font.psf > font.h
+//
+// -n  name of the struct cuoreterm_font (default font)
+// -a  pad each glyph to a multiple of align bytes (power of two up to 64, default 16) so glyph g starts
+//     at g * glyph_bytes and never straddles a cache line it does not have to, 1 packs them
+// -p  also expand every glyph into pixels of this format (limine's mask sizes and shifts) in fg on bg
+//     (hex 0xRRGGBB, default ffffff on 000000), cells in those colours are then plain row copies
+#define CUORETERM_IMPL
+#define CUORETERM_NO_SIMD
+#include "../Cuoreterm.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define CP_MAX 0x110000
+
+static void usage(void) {
+    fprintf(stderr, "usage: cuorefont [-n name] [-a align] [-p bpp:rs:rsh:gs:gsh:bs:bsh[:fg:bg]] font.psf\n");
+    exit(1);
+}
+
+static uint32_t le32(const uint8_t *p) {
+    return p[0] | (p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+// the header has to describe glyphs that are all in the file, and a unicode table, when it says there
+// is one, has to end all count entries before the file does. checked before the library sees the font
+static const char *check_psf(const uint8_t *data, size_t size) {
+    uint64_t hdr, count, bytes, rows, width;
+    int table, utf8 = 0;
+
+    if (size >= 32 && le32(data) == 0x864AB572) {
+        hdr = le32(data + 8);
+        count = le32(data + 16);
+        bytes = le32(data + 20);
+        rows = le32(data + 24);
+        width = le32(data + 28);
+        table = utf8 = le32(data + 12) & 1;
+        if (hdr < 32 || hdr > size) return "bad psf2 header";
+    } else if (size >= 4 && data[0] == 0x36 && data[1] == 0x04) {
+        hdr = 4;
+        count = data[2] & 0x01 ? 512 : 256;
+        bytes = rows = data[3];
+        width = 8;
+        table = (data[2] & 0x06) != 0;
+    } else {
+        return "not a psf font";
+    }
+
+    if (!count || !rows || !width || width > 0xFFFF || bytes < (width + 7) / 8 * rows) return "bad glyph size";
+    if (hdr + count * bytes > size) return "glyphs cut short";
+    if (!table) return 0;
+
+    // every entry ends with 0xffff, a single 0xff byte in psf2's utf-8
+    const uint8_t *p = data + hdr + count * bytes, *end = data + size;
+    for (uint64_t g = 0; g < count; g++) {
+        for (;;) {
+            if (p + (utf8 ? 1 : 2) > end) return "unicode table cut short";
+            if (utf8 ? *p++ == 0xFF : (p += 2, p[-2] == 0xFF && p[-1] == 0xFF)) break;
+        }
+    }
+    return 0;
+}
+
+static void emit_bytes(const uint8_t *p, size_t n) {
+    for (size_t i = 0; i < n; i++) printf("%s0x%02x,%s", i % 16 ? " " : "    ", p[i], i % 16 == 15 || i + 1 == n ? "\n" : "");
+}
+
+static void emit_u16(const uint16_t *p, size_t n) {
+    for (size_t i = 0; i < n; i++) printf("%s%u,%s", i % 16 ? " " : "    ", p[i], i % 16 == 15 || i + 1 == n ? "\n" : "");
+}
+
+int main(int argc, char **argv) {
+    const char *name = "font", *path = 0, *pix = 0;
+    uint32_t align = 16;
+
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "-n") && i + 1 < argc) name = argv[++i];
+        else if (!strcmp(argv[i], "-a") && i + 1 < argc) align = (uint32_t)strtoul(argv[++i], 0, 0);
+        else if (!strcmp(argv[i], "-p") && i + 1 < argc) pix = argv[++i];
+        else if (argv[i][0] != '-' && !path) path = argv[i];
+        else usage();
+    }
+    if (!path || !align || align > 64 || (align & (align - 1))) usage();
+
+    FILE *f = fopen(path, "rb");
+    if (!f) { perror(path); return 1; }
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    uint8_t *data = malloc(size > 32 ? (size_t)size : 32);
+    memset(data, 0, 32);
+    if (size <= 0 || size > UINT32_MAX || fread(data, 1, (size_t)size, f) != (size_t)size) { fprintf(stderr, "%s: read failed\n", path); return 1; }
+    fclose(f);
+
+    const char *err = check_psf(data, (size_t)size);
+    if (err) { fprintf(stderr, "%s: %s\n", path, err); return 1; }
+
+    // a tiny terminal to load it into, nothing is ever drawn to the fb
+    static uint8_t fb[8 * 8 * 4];
+    static struct terminal term;
+    cuoreterm_init(&term, fb, 8, 8, 8 * 4, 32, 0, 0, 0);
+    if (!cuoreterm_set_font_sized(&term, data, (uint32_t)size, 0, 0)) { fprintf(stderr, "%s: not a psf font\n", path); return 1; }
+
+    uint16_t *map = malloc(CP_MAX * sizeof(uint16_t));
+    cuoreterm_set_font_map(&term, map, CP_MAX);
+
+    // only as far as the last codepoint the font has, past it everything is missing anyway
+    uint32_t map_size = CP_MAX;
+    while (map_size > 1 && map[map_size - 1] == term.font_missing) map_size--;
+
+    uint32_t w = term.font_glyph_w, h = term.font_glyph_h, stride = term.font_stride;
+    uint32_t gbytes = (stride * h + align - 1) & ~(align - 1);
+    uint8_t *glyphs = calloc(term.glyph_count, gbytes);
+    for (uint32_t g = 0; g < term.glyph_count; g++)
+        memcpy(glyphs + g * gbytes, term.font_bits + g * term.font_bytes, stride * h);
+
+    struct cuoreterm_format fmt = { 0 };
+    uint32_t fg = 0xFFFFFF, bg = 0x000000;
+    uint8_t *pixels = 0;
+    size_t pixels_size = 0;
+
+    if (pix) {
+        unsigned v[9] = { 0, 0, 0, 0, 0, 0, 0, 0xFFFFFF, 0 };
+        int n = sscanf(pix, "%u:%u:%u:%u:%u:%u:%u:%x:%x", &v[0], &v[1], &v[2], &v[3], &v[4], &v[5], &v[6], &v[7], &v[8]);
+        if (n != 7 && n != 9) usage();
+        for (int i = 0; i < 7; i++) if (v[i] > 255) usage();
+        fmt = (struct cuoreterm_format){ (uint8_t)v[0], (uint8_t)v[1], (uint8_t)v[2], (uint8_t)v[3], (uint8_t)v[4], (uint8_t)v[5], (uint8_t)v[6] };
+        fg = v[7];
+        bg = v[8];
+
+        // the same expansion the glyph cache does, glyph_w x glyph_h cells in that format
+        if (!cuoreterm_set_format(&term, &fmt)) {
+            fprintf(stderr, "cuorefont: bad pixel format %s\n", pix);
+            return 1;
+        }
+        uint32_t row_bytes = w * term.pixel_bytes;
+        pixels_size = (size_t)term.glyph_count * h * row_bytes;
+        pixels = malloc(pixels_size);
+        for (uint32_t g = 0; g < term.glyph_count; g++)
+            for (uint32_t r = 0; r < h; r++)
+                term.ops->expand(pixels + ((size_t)g * h + r) * row_bytes, term.font_bits + g * term.font_bytes + r * stride,
+                                 w, w, term_pack(&fmt, fg), term_pack(&fmt, bg));
+    }
+
+    printf("// generated by cuorefont from %s, do not edit\n", path);
+    printf("// %ux%u, %u glyphs, codepoints below %u mapped\n\n", w, h, term.glyph_count, map_size);
+
+    printf("static const uint8_t %s_glyphs[] __attribute__((aligned(64))) = {\n", name);
+    emit_bytes(glyphs, (size_t)term.glyph_count * gbytes);
+    printf("};\n\n");
+
+    printf("static const uint16_t %s_map[] = {\n", name);
+    emit_u16(map, map_size);
+    printf("};\n\n");
+
+    if (pixels) {
+        printf("static const uint8_t %s_pixels[] __attribute__((aligned(64))) = {\n", name);
+        emit_bytes(pixels, pixels_size);
+        printf("};\n\n");
+    }
+
+    printf("__attribute__((unused)) static const struct cuoreterm_font %s = {\n", name);
+    printf("    .glyph_w = %u, .glyph_h = %u,\n", w, h);
+    printf("    .stride = %u, .glyph_bytes = %u,\n", stride, gbytes);
+    printf("    .glyph_count = %u,\n", term.glyph_count);
+    printf("    .glyphs = %s_glyphs,\n", name);
+    printf("    .map = %s_map,\n", name);
+    printf("    .map_size = %u,\n", map_size);
+    printf("    .missing = %u,\n", term.font_missing);
+    if (pixels) {
+        printf("    .pixels = %s_pixels,\n", name);
+        printf("    .pixel_fmt = { %u, %u, %u, %u, %u, %u, %u },\n", fmt.bpp, fmt.r_size, fmt.r_shift, fmt.g_size, fmt.g_shift, fmt.b_size, fmt.b_shift);
+        printf("    .pixel_fg = 0x%06X, .pixel_bg = 0x%06X,\n", fg, bg);
+    }
+    printf("};\n");
+
+    free(pixels);
+    free(glyphs);
+    free(map);
+    free(data);
+    return 0;
+}